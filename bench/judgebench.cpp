@@ -0,0 +1,202 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    End-to-end judge throughput benchmark.
+
+    Usage: judgebench.exe [themisv2.exe] [tests] [parallelism] [results]
+    - [themisv2.exe] is the judge to benchmark (default: themisv2.exe).
+    - [tests] is the number of tests of the synthetic problem (default: 20).
+    - [parallelism] is a list of levels split by commas, eg. 1,2,4 (default: 1,2,4).
+    - [results] is where the results are written (default: judgebench.txt).
+    Run it from themisv2's folder (the one holding src\C++ and src\Pascal), as you do with themisv2.
+
+    UNDERSTANDING:
+    --------------
+    - A synthetic a+b problem and seven synthetic solutions are generated in judgebench\:
+      AC, WA, TLE busy-loop, sleep-forever, MLE allocator, crash and output flood.
+    - Every solution is one submission. For each parallelism level *p*, all submissions are judged by
+      running the whole themisv2 pipeline, *p* at a time, each with its own temporary folder and trace.
+    - Judge overhead per test = (time of the "run tests" phase - solution times) / tests. Both are wall times: the
+      solution's "Time used" (not its CPU time) is what a test spends running it, so a sleeping solution's wait
+      is not counted as the judge's.
+    - Verdict latency = time from starting themisv2 to its exit, compilation included.
+**/
+#include "../src/utility.h"
+
+/* Synthetic solutions: name and source code. */
+const char* solutions[][2] = {
+    {"ac",    "#include <stdio.h>\nint main(){long long a,b;scanf(\"%lld%lld\",&a,&b);printf(\"%lld\\n\",a+b);}\n"},
+    {"wa",    "#include <stdio.h>\nint main(){long long a,b;scanf(\"%lld%lld\",&a,&b);printf(\"%lld\\n\",a+b+1);}\n"},
+    {"tle",   "int main(){volatile unsigned x=0;for(;;)++x;}\n"},
+    {"sleep", "#include <windows.h>\nint main(){Sleep(INFINITE);}\n"},
+    {"mle",   "#include <stdlib.h>\n#include <string.h>\nint main(){for(;;){char*p=(char*)malloc(1<<20);if(!p)return 1;memset(p,1,1<<20);}}\n"},
+    {"crash", "int main(){*(volatile int*)0=0;}\n"},
+    {"flood", "#include <stdio.h>\nint main(){long long a,b;scanf(\"%lld%lld\",&a,&b);printf(\"%lld\\n\",a+b);for(int i=0;i<(1<<24);++i)fputs(\"flood \",stdout);}\n"}
+};
+const int num_solutions = sizeof solutions / sizeof solutions[0];
+
+/* A self-contained checker comparing two integers. */
+const char* checker_source =
+    "#include <stdio.h>\n"
+    "int main(int argc,char**argv){long long x,y;FILE*o=fopen(argv[2],\"r\"),*a=fopen(argv[3],\"r\");\n"
+    "if(o&&a&&fscanf(o,\"%lld\",&x)==1&&fscanf(a,\"%lld\",&y)==1&&x==y){puts(\"1\\nCorrect.\");return 0;}\n"
+    "puts(\"0\\nWrong answer.\");return 1;}\n";
+
+/* One judged submission. */
+struct job {
+    int    sol;
+    proc*  p;
+    double begin, end;
+};
+
+/* Seconds since an arbitrary point. */
+double seconds() {
+    static LARGE_INTEGER freq;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / freq.QuadPart;
+}
+
+/* Write a whole text file. */
+void writefile (const string& fn, const string& content) {
+    ofstream f(fn);
+    if (!f.is_open())
+        halt(crash, rfmt("Judgebench: Cannot write \"%s\"!", fn.c_str()));
+    f << content;
+}
+
+/* Generate the problem, the checker, the solutions and one config per solution. */
+void generate (const string& dir, int tests) {
+    system(rfmt("mkdir \"%s\\tests\" >nul 2>&1", dir.c_str()).c_str());
+    mt19937 g(20170101);
+    for (int i = 0; i < tests; ++i) {
+        ll a = g() % 1000000000, b = g() % 1000000000;
+        string id = string("0") * (i < 10) + to_string(i);
+        writefile(rfmt("%s\\tests\\%s.in", dir.c_str(), id.c_str()), rfmt("%s %s\n", to_string(a).c_str(), to_string(b).c_str()));
+        writefile(rfmt("%s\\tests\\%s.ans", dir.c_str(), id.c_str()), to_string(a + b) + "\n");
+    }
+    writefile(dir + "\\checker.cpp", checker_source);
+
+    string strength = to_string(tests) + string(" 1") * tests,
+           tls      = to_string(tests) + string(" 200") * tests,
+           mls      = to_string(tests) + string(" 65536") * tests;
+    for (int i = 0; i < num_solutions; ++i) {
+        writefile(rfmt("%s\\%s.cpp", dir.c_str(), solutions[i][0]), solutions[i][1]);
+        writefile(rfmt("%s\\%s.cfg", dir.c_str(), solutions[i][0]),
+                  rfmt("normal\nnormal\n%s\\%s.cpp\n%s\\checker.cpp\nstdio\n\n\n%s\\tests\n%s\n100\n%s\n%s\n\n\n",
+                       dir.c_str(), solutions[i][0], dir.c_str(), dir.c_str(),
+                       strength.c_str(), tls.c_str(), mls.c_str()));
+    }
+}
+
+/* Sum of "Time used" (wall time) of all tests in a judge's log. */
+double solutiontime (const string& fn) {
+    ifstream f(fn);
+    string s;
+    double r = 0;
+    while (getline(f, s)) {
+        size_t k = s.find("Time used: ");
+        if (k != string::npos)
+            r += atof(s.c_str() + k + 11);
+    }
+    return r;
+}
+
+/* Duration (in ms) of a phase in a trace written by themisv2. */
+double phase (const string& fn, const string& name) {
+    ifstream f(fn);
+    string s, key = "\"name\":\"" + name + "\"";
+    double r = 0;
+    while (getline(f, s))
+        if (s.find(key) != string::npos) {
+            size_t k = s.find("\"dur\":");
+            if (k != string::npos)
+                r += atof(s.c_str() + k + 6) / 1000;
+        }
+    return r;
+}
+
+int main (int argc, char* argv[]) {
+    string judge = argc > 1 ? argv[1] : "themisv2.exe",
+           out   = argc > 4 ? argv[4] : "judgebench.txt";
+    int tests    = argc > 2 ? atoi(argv[2]) : 20;
+    vector<string> levels = split(argc > 3 ? argv[3] : "1,2,4", ',');
+
+    char cwd[MAX_PATH];
+    if (!GetCurrentDirectory(MAX_PATH, cwd))
+        halt(crash, "Judgebench: Cannot get current directory!");
+    string dir = string(cwd) + "\\judgebench";
+    if (judge.find('\\') == string::npos)
+        judge = string(cwd) + "\\" + judge;
+
+    generate(dir, tests);
+    ofstream res(out);
+    res << rfmt("# themisv2 judgebench [%s] tests=%d", dt().c_str(), tests) << endl;
+
+    for (size_t l = 0; l < levels.size(); ++l) {
+        int p = max(1, atoi(levels[l].c_str()));
+        vector<job> jobs;
+        for (int i = 0; i < num_solutions; ++i)
+            jobs.pb(job{i, NULL, 0, 0});
+
+        // Judge all submissions, *p* at a time.
+        double begin = seconds();
+        size_t next = 0, done = 0, running = 0;
+        while (done < jobs.size()) {
+            while (running < (size_t)p && next < jobs.size()) {
+                job& j = jobs[next];
+                string name = rfmt("%s\\%s.p%d", dir.c_str(), solutions[j.sol][0], p);
+                SetEnvironmentVariable("THEMISV2_TEMP", (name + ".tmp").c_str());
+                SetEnvironmentVariable("THEMISV2_CONFIG", rfmt("%s\\%s.cfg", dir.c_str(), solutions[j.sol][0]).c_str());
+                SetEnvironmentVariable("THEMISV2_TRACE", (name + ".json").c_str());
+                j.p     = new proc(judge, "", inf, inf, "", name + ".log", name + ".log");
+                j.begin = seconds();
+                j.p->start();
+                ++next, ++running;
+            }
+            Sleep(5);
+            for (size_t i = 0; i < next; ++i)
+                if (jobs[i].p && !jobs[i].p->opening()) {
+                    jobs[i].end = seconds();
+                    jobs[i].p->stop();
+                    delete jobs[i].p;
+                    jobs[i].p = NULL;
+                    ++done, --running;
+                }
+        }
+        double elapsed = seconds() - begin;
+
+        // Report.
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            string name = rfmt("%s\\%s.p%d", dir.c_str(), solutions[jobs[i].sol][0], p);
+            double latency  = (jobs[i].end - jobs[i].begin) * 1000,
+                   overhead = (phase(name + ".json", "run tests") - solutiontime(name + ".log")) / tests;
+            string line = rfmt("p=%d\t%s\tlatency_ms=%f\twall_overhead_ms_per_test=%f",
+                               p, solutions[jobs[i].sol][0], latency, overhead);
+            res << line << endl;
+            cout << line << endl;
+        }
+        string line = rfmt("p=%d\tall\tsubmissions_per_hour=%f", p, jobs.size() / elapsed * 3600);
+        res << line << endl;
+        cout << line << endl;
+    }
+    res.close();
+    return 0;
+}
@@ -0,0 +1,308 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Microbenchmarks for themisv2's hot components.
+
+    Usage: microbench.exe [results] [tokens] [label]
+           microbench.exe --compare [old results] [new results]
+           microbench.exe --noop (used by the spawn benchmark)
+    - [results] is where the results are written (default: microbench.txt).
+    - [tokens] is the number of tokens in the generated files (default: 1000000).
+    - [label] is written in the header of the results, eg. a commit hash.
+    Every benchmark is run *rounds* times and the best round is reported.
+    Inputs are generated with fixed seeds so results are comparable across commits.
+    Before measuring, foo and the token stream read the same edge cases (unsigned, signed and real numbers) and must agree.
+**/
+#include "../src/utility.h"
+#include "../src/checker.h"
+#include "../src/randomer.h"
+#include <map>
+
+const int rounds = 5; /* Rounds per benchmark. */
+
+/* Results: name, value and unit. */
+vector<pair<string, pair<double, string> > > results;
+
+/* Seconds since an arbitrary point. */
+double seconds() {
+    static LARGE_INTEGER freq;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / freq.QuadPart;
+}
+
+/* Save and print one result. */
+void report (const string& name, double value, const string& unit) {
+    results.pb(mp(name, mp(value, unit)));
+    cout << rfmt("%s: %f %s", name.c_str(), value, unit.c_str()) << endl;
+}
+
+/* Size of a file in bytes. */
+double filesize (const string& fn) {
+    ifstream f(fn, ios::binary | ios::ate);
+    return (double)f.tellg();
+}
+
+/* Generate *tokens* tokens of some kind, 16 per line. */
+void generate (const string& fn, ll tokens, char kind) {
+    mt19937 g(20170101);
+    FILE* f = fopen(fn.c_str(), "w");
+    if (!f)
+        halt(crash, "Microbench: Cannot create generated file!");
+    for (ll i = 0; i < tokens; ++i) {
+        if (kind == 'i')
+            fprintf(f, "%d", (int)(g() % 2000000000) - 1000000000);
+        else if (kind == 'd')
+            fprintf(f, "%d.%06d", (int)(g() % 2000000) - 1000000, (int)(g() % 1000000));
+        else {
+            int len = 1 + g() % 12;
+            for (int j = 0; j < len; ++j)
+                fputc('a' + g() % 26, f);
+        }
+        fputc((i % 16 == 15 || i + 1 == tokens) ? '\n' : ' ', f);
+    }
+    fclose(f);
+}
+
+/* Read a generated file with a stream (foo or tokenstream), token by token. Returns the number of tokens read. */
+template<typename S>
+ll readall (S& in, char kind) {
+    ll cnt = 0;
+    for (;;) {
+        int ret;
+        if (kind == 'i') {
+            int n;
+            ret = in.readint(n);
+        } else if (kind == 'd') {
+            double n;
+            ret = in.readdouble(n);
+        } else {
+            string w;
+            ret = in.readword(w);
+        }
+        if (ret == 3) {
+            // End of line, jump to the next one.
+            in.itsOK();
+            if (in.readline() == EOF)
+                break;
+            continue;
+        }
+        if (ret)
+            halt(crash, "Microbench: Generated file cannot be read!");
+        ++cnt;
+    }
+    return cnt;
+}
+
+/* Run *f* for every round and return the best time in seconds. */
+template<typename F>
+double best (F f) {
+    double r = 1e18;
+    for (int i = 0; i < rounds; ++i) {
+        double t = seconds();
+        f();
+        mini(r, seconds() - t);
+    }
+    return r;
+}
+
+/* Read the same edge cases (one per line) with foo and a token stream, and halt if they do not agree. */
+void check_tokens() {
+    const char* fn = "microbench_edge.txt";
+    const char* cases[][2] = {
+        {"u", "0"}, {"u", "9223372036854775808"}, {"u", "18446744073709551615"}, {"u", "18446744073709551616"}, {"u", "-5"},
+        {"i", "-"}, {"i", "2147483647"}, {"i", "-2147483648"}, {"i", "-2147483647"},
+        {"d", "-"}, {"d", ".5"}, {"d", "-.5"}, {"d", "5."}, {"d", "9007199254740993"}, {"d", "0.1234567890123456789"}
+    };
+    const int n = sizeof cases / sizeof cases[0];
+    FILE* f = fopen(fn, "w");
+    if (!f)
+        halt(crash, "Microbench: Cannot create generated file!");
+    for (int i = 0; i < n; ++i)
+        fprintf(f, "%s\n", cases[i][1]);
+    fclose(f);
+
+    foo         a(fn);
+    tokenstream b(fn, "");
+    for (int i = 0; i < n; ++i) {
+        bool same;
+        if (*cases[i][0] == 'u') {
+            ull x, y;
+            same = a.readint(x) == b.readint(y) && x == y;
+        } else if (*cases[i][0] == 'i') {
+            int x, y;
+            same = a.readint(x) == b.readint(y) && x == y;
+        } else {
+            double x, y;
+            same = a.readdouble(x) == b.readdouble(y) && !memcmp(&x, &y, sizeof x);
+        }
+        if (!same)
+            halt(crash, rfmt("Microbench: foo and the token stream do not agree on \"%s\"!", cases[i][1]));
+        a.itsOK(), b.itsOK();
+        a.readline(), b.readline();
+        a.itsOK(), b.itsOK();
+    }
+    remove(fn);
+}
+
+/* --- Benchmarks start here --- */
+
+void bench_instream (ll tokens) {
+    const char kinds[] = {'i', 'd', 'w'};
+    const char* names[] = {"readint", "readdouble", "readword"};
+    for (int k = 0; k < 3; ++k) {
+        string fn = rfmt("microbench_%c.txt", kinds[k]);
+        generate(fn, tokens, kinds[k]);
+        double bytes = filesize(fn);
+        ll cnt = 0;
+        double t = best([&]() { foo in(fn); cnt = readall(in, kinds[k]); });
+        if (cnt != tokens)
+            halt(crash, "Microbench: Wrong number of tokens read!");
+        report(rfmt("instream.%s", names[k]), cnt / t, "tokens/s");
+        report(rfmt("instream.%s", names[k]), bytes / t / 1048576, "MB/s");
+
+        // Token stream: the first round tokenizes and caches the file, the others read the cache.
+        t = best([&]() { tokenstream in(fn, "."); cnt = readall(in, kinds[k]); });
+        if (cnt != tokens)
+            halt(crash, "Microbench: Wrong number of tokens read!");
+        report(rfmt("tokens.%s", names[k]), cnt / t, "tokens/s");
+        report(rfmt("tokens.%s", names[k]), bytes / t / 1048576, "MB/s");
+
+        ifstream f(fn, ios::binary);
+        string raw((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        f.close();
+        struct stat st;
+        remove(tokencache(".", raw.data(), raw.size()).c_str());
+        if (!stat(fn.c_str(), &st))
+            remove(tokencache(".", fn, st).c_str());
+        remove(fn.c_str());
+    }
+}
+
+void bench_duplicate (ll tokens) {
+    generate("microbench_dup.in", tokens, 'i');
+    double bytes = filesize("microbench_dup.in");
+    double t = best([]() { duplicate("microbench_dup.in", "microbench_dup.out"); });
+    report("duplicate", bytes / t / 1048576, "MB/s");
+    remove("microbench_dup.in");
+    remove("microbench_dup.out");
+}
+
+void bench_rfmt() {
+    const int calls = 200000;
+    string r;
+    double t = best([&]() {
+        for (int i = 0; i < calls; ++i)
+            r = rfmt("Memory used: %d KB --- Time used: %d ms (%s) %f", i, calls - i, "test", 0.5);
+    });
+    report("rfmt", calls / t, "calls/s");
+}
+
+void bench_split_join() {
+    string s;
+    for (int i = 0; i < 100000; ++i)
+        s += "C:\\themisv2\\tests\\" + to_string(i) + "\\";
+    vector<string> v;
+    double t = best([&]() { v = split(s, '\\'); });
+    report("split", s.size() / t / 1048576, "MB/s");
+    string r;
+    t = best([&]() { r = join(v, '\\'); });
+    if (r != s)
+        halt(crash, "Microbench: split() and join() do not match!");
+    report("join", r.size() / t / 1048576, "MB/s");
+}
+
+void bench_spawn (const string& self) {
+    const int spawns = 50;
+    double t = best([&]() {
+        for (int i = 0; i < spawns; ++i) {
+            proc a(self, "--noop", inf, inf);
+            a.run_and_wait();
+            a.stop();
+        }
+    });
+    report("proc.spawn", spawns / t, "spawns/s");
+    report("proc.spawn", t / spawns * 1000, "ms/spawn");
+}
+
+void bench_randomer() {
+    const int n = 1000000;
+    gen.seed(20170101);
+    double t = best([&]() { random_tree(n); });
+    report("randomer.random_tree", n / t, "edges/s");
+    t = best([&]() { random_graph(n, n); });
+    report("randomer.random_graph", n / t, "edges/s");
+    t = best([&]() { random_string(n, {{'a', 'z'}, {'0', '9'}}); });
+    report("randomer.random_string", n / t, "chars/s");
+}
+
+/* Print the change of every result between two results files. */
+int compare (const string& a, const string& b) {
+    map<string, double> old;
+    ifstream p(a), q(b);
+    string s;
+    while (getline(p, s)) {
+        vector<string> r = split(s, '\t');
+        if (r.size() == 3)
+            old[r[0] + " " + r[2]] = atof(r[1].c_str());
+    }
+    while (getline(q, s)) {
+        vector<string> r = split(s, '\t');
+        if (r.size() != 3 || !old.count(r[0] + " " + r[2]))
+            continue;
+        double x = old[r[0] + " " + r[2]], y = atof(r[1].c_str());
+        cout << rfmt("%s (%s): %f -> %f (%s%f percent)", r[0].c_str(), r[2].c_str(), x, y, y >= x ? "+" : "", x ? (y - x) / x * 100 : 0.0) << endl;
+    }
+    return 0;
+}
+
+int main (int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--noop")
+        return 0;
+    if (argc > 3 && string(argv[1]) == "--compare")
+        return compare(argv[2], argv[3]);
+
+    string out   = argc > 1 ? argv[1] : "microbench.txt",
+           label = argc > 3 ? argv[3] : "";
+    ll tokens    = argc > 2 ? atoll(argv[2]) : 1000000;
+
+    char self[MAX_PATH];
+    if (!GetModuleFileName(NULL, self, MAX_PATH))
+        halt(crash, "Microbench: Cannot get my own destination!");
+
+    check_tokens();
+    bench_instream(tokens);
+    bench_duplicate(tokens);
+    bench_rfmt();
+    bench_split_join();
+    bench_spawn(self);
+    bench_randomer();
+
+    // Write results, one per line: name, value and unit split by tabs.
+    ofstream res(out);
+    res << rfmt("# themisv2 microbench [%s] %s tokens=%s", dt().c_str(), label.c_str(), to_string(tokens).c_str()) << endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        char v[64];
+        snprintf(v, sizeof v, "%.3f", results[i].se.fi);
+        res << results[i].fi << "\t" << v << "\t" << results[i].se.se << endl;
+    }
+    res.close();
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include "themisv2.h"
 #include <limits>
 #include <stdexcept>
+#include "tokens.h"
 
 string input, output, answer;
 
@@ -60,6 +61,17 @@ T mul (T a, _T b) {
     return 0;
 }
 
+/* A piece of memory as a stream buffer. Nothing is copied. */
+class __themisv2_membuf__ : public streambuf {
+public:
+    __themisv2_membuf__ (const char* p = "", size_t n = 0) {
+        char* q = const_cast<char*> (p);
+        setg(q, q, q + n);
+    }
+};
+
+typedef __themisv2_membuf__ membuf;
+
 /* New override input stream for handling formal output!
    STRICTLY RECOMMENDED using *foo* instead of based stream.
 
@@ -76,17 +88,20 @@ T mul (T a, _T b) {
 */
 class __themisv2_instream__ {
 private:
-    /* ifstream bar for reading file, stringstream ss for handling cases and bool _f for
-       reminding judger to check exitcodes.
+    /* ifstream bar for reading file (or istream mem over membuf buf for reading memory), *in* for the one in use,
+       stringstream ss for handling cases and bool _f for reminding judger to check exitcodes.
     */
     ifstream bar;
+    membuf buf;
+    istream mem;
+    istream* in;
     stringstream ss;
     bool _f;
     string z;
 public:
     /* Registration with file name. */
     template<typename T>
-    __themisv2_instream__ (const T& fname) {
+    __themisv2_instream__ (const T& fname): mem(NULL), in(&bar) {
         bar.open(fname);
         if (!bar.is_open())
             halt(crash, "Instream: Can't open file!");
@@ -97,9 +112,18 @@ public:
         _f = 0;
     }
 
+    /* Registration with *n* bytes of memory (eg. in a checker plugin). */
+    __themisv2_instream__ (const char* data, size_t n): buf(data, n), mem(&buf), in(&mem) {
+		if (!getline(mem, z))
+			halt(crash, "Instream: Empty file!");
+        ss.str(z);
+        ss.seekg(0);
+        _f = 0;
+    }
+
     /* Make sure everything before reading. */
     void analyze() {
-        if (!bar.is_open())
+        if (in == &bar && !bar.is_open())
             halt(crash, "Instream: You must register before using my input stream!");
         if (_f)
             halt(crash, "Instream: Be careful to check all exitcodes! There was an non-zero returned exitcode at the previous use of my input stream.");
@@ -192,14 +216,16 @@ public:
         // Otherwise, renew the buffer.
 
         if (ss.peek() != EOF) {
-            if (getline(bar, z)) {
+            if (getline(*in, z)) {
+                ss.clear();
                 ss.str(z);
                 ss.seekg(0);
             }
             return _f = 1, 1;
         }
-        if (!getline(bar, z))
+        if (!getline(*in, z))
             return _f = 1, EOF;
+        ss.clear();
         ss.str(z);
         ss.seekg(0);
         return 0;
@@ -366,4 +392,134 @@ void regis_checker (int argc, char* argv[]) {
     answer = argv[3];
 }
 
+/* --- Batch checker tools begin here --- */
+
+/* A batch checker is started once per submission and checks all its tests, so anything heavy it loads is loaded once.
+   Write it as a loop and it works both as a batch checker and as a usual one:
+
+       int main (int argc, char* argv[]) {
+           regis_batch_checker(argc, argv);
+           // Load dictionaries, tables, ...
+           while (next_test()) {
+               foo out(output), ans(answer);
+               // Check.
+               reply(1, "OK");
+           }
+       }
+
+   Let themisv2 know with "checker = batch" in the problem's options (see judge.h).
+
+   PROTOCOL:
+   ---------
+   - The checker is started with "--batch" as its only argument.
+   - For every test, themisv2 writes three lines to its stdin: the input, the output and the answer's destinations.
+     Its stdin ends when there is no test left.
+   - For every test, in order, the checker writes "<score> <number of lines>" then its comment's lines to its stdout.
+   So nothing else should be written to stdout.
+*/
+bool __batch__;
+
+/* Usage: checker.exe --batch, or as regis_checker(). */
+void regis_batch_checker (int argc, char* argv[]) {
+    __batch__ = argc == 2 && string(argv[1]) == "--batch";
+    if (!__batch__)
+        regis_checker(argc, argv);
+}
+
+/* Get the next test in *input*, *output* and *answer*. Returns 0 if there is no test left. */
+bool next_test() {
+    static bool first = 1;
+    if (!__batch__) {
+        bool r = first;
+        first = 0;
+        return r;
+    }
+    return getline(cin, input) && getline(cin, output) && getline(cin, answer);
+}
+
+/* Give the score (in range [0, 1]) and the comment of the current test. */
+void reply (double score, const string& comment = "") {
+    char s[32];
+    snprintf(s, sizeof s, "%.12g", score);
+    if (!__batch__) {
+        cout << s << "\n" << comment << endl;
+        return;
+    }
+    vector<string> lines = split(comment, '\n');
+    if (comment.empty())
+        lines.clear();
+    cout << s << " " << lines.size() << "\n";
+    for (size_t i = 0; i < lines.size(); ++i)
+        cout << lines[i] << "\n";
+    cout.flush();
+}
+
+/* --- Checker plugin tools begin here --- */
+
+/* A checker plugin is a DLL that themisv2 loads and calls for every test, so no process is started per test.
+   Tests are given as pieces of memory: read them with foo's memory registration.
+
+       THEMISV2_PLUGIN_CHECKER {
+           foo out(output_data, output_size), ans(answer_data, answer_size);
+           // Check.
+           comment = "OK";
+           return 1;
+       }
+
+   Build it with "g++ -std=c++11 -O2 -shared -static-libgcc -static-libstdc++ -DTHEMISV2 checker.cpp -o checker.dll"
+   and let themisv2 know with "checker = plugin" (or "checker = isolated-plugin") in the problem's options (see judge.h).
+   The plugin has thread_local state (see halt()), which MinGW keeps through libgcc's emulated TLS: linking libgcc and
+   libstdc++ statically keeps the DLL loadable where their DLLs are not on the PATH.
+   It may be called by several threads at once, so keep it free of globals.
+
+   ENTRY POINT (C ABI):
+   --------------------
+   double check (const char* input,  size_t input_size,
+                 const char* output, size_t output_size,
+                 const char* answer, size_t answer_size,
+                 char* message, size_t message_size);
+   It returns the score in range [0, 1], or a negative number if the checker fails. Either way,
+   *message* gets the comment (or what failed), cut to *message_size* bytes with the ending zero.
+*/
+typedef double (*__themisv2_checkfn__) (const char*, size_t, const char*, size_t, const char*, size_t, char*, size_t);
+typedef double (*__themisv2_pluginfn__) (const char*, size_t, const char*, size_t, const char*, size_t, string&);
+
+typedef __themisv2_checkfn__ checkfn;
+
+/* Call a plugin's checking function. Halts become failures, logs are dropped. */
+double __plugin_call__ (__themisv2_pluginfn__ fn,
+                        const char* in, size_t inlen, const char* out, size_t outlen, const char* ans, size_t anslen,
+                        char* msg, size_t msglen) {
+    bool   throws = __halt_throws__;
+    string logs, comment;
+    double r;
+    __halt_throws__ = 1;
+    {
+        logcapture lc(&logs);
+        try {
+            r = fn(in, inlen, out, outlen, ans, anslen, comment);
+        } catch (const judgeerror& e) {
+            r       = -1;
+            comment = e.message;
+        }
+    }
+    __halt_throws__ = throws;
+    if (msglen) {
+        size_t n = min(comment.size(), msglen - 1);
+        memcpy(msg, comment.data(), n);
+        msg[n] = 0;
+    }
+    return r;
+}
+
+#define THEMISV2_PLUGIN_CHECKER \
+    double __themisv2_plugin__ (const char*, size_t, const char*, size_t, const char*, size_t, string&); \
+    extern "C" __declspec(dllexport) double check (const char* in, size_t inlen, const char* out, size_t outlen, \
+                                                   const char* ans, size_t anslen, char* msg, size_t msglen) { \
+        return __plugin_call__(__themisv2_plugin__, in, inlen, out, outlen, ans, anslen, msg, msglen); \
+    } \
+    double __themisv2_plugin__ (const char* input_data,  size_t input_size, \
+                                const char* output_data, size_t output_size, \
+                                const char* answer_data, size_t answer_size, string& comment)
+
 #endif // __THEMISV2_CHECKER__
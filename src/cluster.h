@@ -0,0 +1,453 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the coordinator and the workers: judging one submission on many machines.
+**/
+#ifndef __THEMISV2_CLUSTER__
+#define __THEMISV2_CLUSTER__
+
+#include "judge.h"
+#include "network.h"
+#include <deque>
+
+/* PROTOCOL:
+   ---------
+   A worker connects to the coordinator and sends "HELLO <name> <key>", *key* being the cluster's shared secret
+   (THEMISV2_CLUSTER_KEY): a peer without it is dropped, as it would get the tests and give verdicts. Then, for every job:
+   [coordinator] "JOB <n>", then a line with the *n* tests to run.
+   [coordinator] "FILE <name>" for the solution, the checker and the test pack, in that order.
+                 Names are content hashes with the extension, so a worker keeps every file it got and never gets it twice.
+   [worker]      "HAVE" if it has the file, "SEND" if it has not. Then the coordinator sends the blob "DATA <size>".
+                 The worker drops the connection if the data does not match the hash in its name.
+   [coordinator] The blobs "CONFIG <size>" and "OPTIONS <size>": the config and the problem's options, as they are.
+   [worker]      "WAIT" every __PEER_BEAT__ ms while it judges.
+   [worker]      The blob "RESULT <size>" for every finished test of the job: "<test> <score ratio>", then the logs of the test.
+   [worker]      The blob "DONE <size>": "<exitcode>", then the error (if any).
+   A worker that says nothing for __PEER_LIMIT__ ms, or breaks the protocol, is lost.
+*/
+const ui __PEER_HELLO__ = 1000;  /* Longest wait for a new connection's "HELLO" (ms). */
+const ui __PEER_LIMIT__ = 60000; /* Longest silence of a worker (ms). */
+const ui __PEER_BEAT__  = 5000;  /* How often a judging worker says "WAIT" (ms). */
+
+/* Name of a file for the workers: its content's hash and its extension. */
+inline string blobname (const string& fn) {
+    size_t k = fn.rfind('.');
+    return tohex(hashfile(fn)) + (k == string::npos ? "" : fn.substr(k));
+}
+
+/* A worker as seen by the coordinator. */
+struct peer {
+    string                 name;
+    unique_ptr<connection> link;
+    set<string>            held;  /* Files it has. */
+    bool                   alive;
+
+    peer(): alive(1) {}
+};
+
+/* The coordinator: it waits for workers, then splits every submission's tests among them (see judgecontext::remote).
+   Workers holding the submission's test pack are preferred; others only get tests the holders cannot take right away.
+   The results are scored by the judge context as usual, so score.txt and the logs are the same as when judging alone.
+   If every worker is lost, the tests left are run by the judge context itself.
+
+   USAGE:
+   ------
+       coordinator c(temp);
+       c.listen(port, "0.0.0.0", key);
+       c.waitworkers(2, 30000);
+       c.attach(judge, config);
+       judge.doall();
+*/
+class __themisv2_coordinator__ {
+private:
+    string                   temp;    /* Temporary folder (test packs are built there). */
+    string                   key;     /* Shared secret workers must say hello with. */
+    listener                 server;
+    vector<unique_ptr<peer>> peers;
+
+    /* One submission being dispatched, shared by the threads talking to the workers (guarded by *cs*). */
+    struct dispatch {
+        __themisv2_coordinator__* self;
+        string                    paths[3], /* Solution, checker and test pack. */
+                                  files[3], /* Their names for the workers. */
+                                  config, options, error;
+        deque<vector<ui>>         shards;
+        map<ui, testresult>*      out;
+        CRITICAL_SECTION          cs;
+    };
+
+    /* What a thread serving one worker gets. */
+    struct task {
+        dispatch* d;
+        peer*     who;
+    };
+
+    /* Take a shard for worker *w*. Returns 0 if it gets nothing. */
+    static bool claim (dispatch& d, peer& w, vector<ui>& shard) {
+        EnterCriticalSection(&d.cs);
+        bool ok = !d.shards.empty() && d.error.empty();
+        if (ok && !w.held.count(d.files[2])) {
+            // Leave the shards to workers holding the tests, unless there are more shards than them.
+            size_t holders = 0;
+            for (size_t i = 0; i < d.self->peers.size(); ++i)
+                holders += d.self->peers[i]->alive && d.self->peers[i]->held.count(d.files[2]);
+            ok = d.shards.size() > holders;
+        }
+        if (ok) {
+            shard = d.shards.front();
+            d.shards.pop_front();
+        }
+        LeaveCriticalSection(&d.cs);
+        return ok;
+    }
+
+    /* Send a file unless the worker has it. */
+    static bool ship (dispatch& d, peer& w, int k) {
+        string s;
+        if (!w.link->sendline("FILE " + d.files[k]) || !w.link->readline(s))
+            return 0;
+        if (s == "SEND") {
+            filemap f;
+            if (!f.open(d.paths[k]))
+                return 0;
+            mapview v = f.view(0, (size_t)f.size());
+            if (!w.link->sendblob("DATA", v.data(), v.size()))
+                return 0;
+        } else if (s != "HAVE")
+            return 0;
+        EnterCriticalSection(&d.cs);
+        w.held.insert(d.files[k]);
+        LeaveCriticalSection(&d.cs);
+        return 1;
+    }
+
+    /* Run a shard on worker *w*. Returns 0 if the worker is lost. */
+    static bool runshard (dispatch& d, peer& w, const vector<ui>& shard) {
+        set<ui> mine(ALL(shard));
+        string ids;
+        for (size_t i = 0; i < shard.size(); ++i)
+            ids += to_string(shard[i]) + " ";
+        if (!w.link->sendline(rfmt("JOB %d", (int)shard.size())) || !w.link->sendline(ids))
+            return 0;
+        for (int k = 0; k < 3; ++k)
+            if (!ship(d, w, k))
+                return 0;
+        if (!w.link->sendblob("CONFIG", d.config.data(), d.config.size()) || !w.link->sendblob("OPTIONS", d.options.data(), d.options.size()))
+            return 0;
+
+        map<ui, testresult> got;
+        for (;;) {
+            string line, blob;
+            if (!w.link->readline(line))
+                return 0;
+            if (line == "WAIT")
+                continue;
+            size_t sp = line.find(' ');
+            string tag = line.substr(0, sp);
+            if ((tag != "RESULT" && tag != "DONE") || sp == string::npos || !w.link->readbytes(blob, (size_t)atoll(line.c_str() + sp + 1)))
+                return 0;
+            size_t e = blob.find('\n');
+            string head = blob.substr(0, e), rest = e == string::npos ? "" : blob.substr(e + 1);
+            if (tag == "DONE") {
+                EnterCriticalSection(&d.cs);
+                if (atoi(head.c_str()) > 1 && d.error.empty())
+                    d.error = rfmt("Worker %s: %s", w.name.c_str(), rest.c_str());
+                for (map<ui, testresult>::iterator it = got.begin(); it != got.end(); ++it)
+                    (*d.out)[it->first] = it->second;
+                LeaveCriticalSection(&d.cs);
+                return 1;
+            }
+            testresult r;
+            if (sscanf(head.c_str(), "%u %lf", &r.id, &r.ratio) != 2 || !mine.count(r.id))
+                return 0;
+            r.logs    = rest;
+            got[r.id] = r;
+        }
+    }
+
+    /* A thread serving one worker until there is nothing left for it. A lost worker's shard goes back to the others. */
+    static DWORD WINAPI serve (LPVOID arg) {
+        task& t = *(task*)arg;
+        vector<ui> shard;
+        while (claim(*t.d, *t.who, shard))
+            if (!runshard(*t.d, *t.who, shard)) {
+                EnterCriticalSection(&t.d->cs);
+                t.who->alive = 0;
+                t.d->shards.push_front(shard);
+                LeaveCriticalSection(&t.d->cs);
+                break;
+            }
+        return 0;
+    }
+
+    /* Read a whole file ("" if there is none). */
+    static string slurp (const string& fn) {
+        ifstream ins(fn, ios::binary);
+        stringstream r;
+        r << ins.rdbuf();
+        return r.str();
+    }
+
+    /* Wait up to *ms* milliseconds for a worker to connect and say hello. Returns NULL if none does. */
+    unique_ptr<peer> greet (ui ms) {
+        unique_ptr<connection> c(server.accept(ms));
+        string s;
+        if (!c)
+            return NULL;
+        c->timeout(__PEER_HELLO__);
+        if (!c->readline(s) || s.compare(0, 6, "HELLO "))
+            return NULL;
+        size_t k = s.find(' ', 6);
+        if (k == string::npos || s.substr(k + 1) != key) {
+            tolog("Coordinator: A peer without the cluster's key is dropped.", LOG_WARN);
+            return NULL;
+        }
+        c->timeout(__PEER_LIMIT__);
+        unique_ptr<peer> w(new peer);
+        w->name = s.substr(6, k - 6);
+        w->link = move(c);
+        tolog(rfmt("Coordinator: Worker %s is connected.", w->name.c_str()), LOG_DEBUG);
+        return w;
+    }
+public:
+    /* A coordinator with its temporary folder (ending with '\'). */
+    __themisv2_coordinator__ (const string& _temp): temp(_temp) {
+        netstart();
+    }
+
+    /* Listen for workers on *port* of the interface *addr*, letting in only those saying hello with *_key*. */
+    void listen (ui port, const string& addr, const string& _key) {
+        if (_key.empty())
+            halt(crash, "Coordinator: The cluster's key (THEMISV2_CLUSTER_KEY) is not set!");
+        key = _key;
+        if (!server.open(port, addr))
+            halt(crash, rfmt("Coordinator: Cannot listen on %s:%d!", addr.c_str(), port));
+    }
+
+    /* Wait until *n* workers are connected, or for *ms* milliseconds. Returns the number of connected workers.
+       Workers connecting later join while a submission is judged.
+    */
+    size_t waitworkers (size_t n, ui ms) {
+        DWORD start = GetTickCount();
+        while (peers.size() < n && GetTickCount() - start < ms) {
+            unique_ptr<peer> w = greet(ms - (GetTickCount() - start));
+            if (w)
+                peers.pb(move(w));
+        }
+        return peers.size();
+    }
+
+    /* Judge the tests *ids* of the submission judged with *config* on the workers.
+       Shards are small enough (a quarter of a worker's share) to keep every worker busy to the end.
+       Workers connecting meanwhile take the shards left.
+    */
+    void judge (const string& config, const string& solution, const string& checker, const string& tests,
+                const vector<ui>& ids, map<ui, testresult>& out) {
+        tracescope ts("coordinate");
+        dispatch d;
+        d.self     = this;
+        d.paths[0] = solution;
+        d.paths[1] = checker;
+        d.paths[2] = tests;
+        if (!ispack(tests)) {
+            // Only packs are sent: build one from the tests' folder, once per test set. A test set is known by its index
+            // (from the manifest, see indextests()), and its pack's name for the workers is kept next to the pack.
+            ifstream ins(config);
+            string s[7];
+            for (int i = 0; i < 7; ++i)
+                getline(ins, s[i]);
+            vector<testentry> index = indextests(tests, s[4] == "stdio", s[5], s[6], temp);
+            string key = tests + "|" + s[4] + "|" + s[5] + "|" + s[6] + "\n";
+            for (size_t i = 0; i < index.size(); ++i)
+                key += index[i].name + " " + to_string(index[i].insize) + " " + to_string(index[i].inmtime) + " "
+                     + to_string(index[i].anssize) + " " + to_string(index[i].ansmtime) + " "
+                     + to_string((int)index[i].inz) + " " + to_string((int)index[i].ansz) + "\n";
+            string base = temp + "cluster_" + tohex(fnv(key.data(), key.size()));
+            d.paths[2] = base + ".pack";
+            d.files[2] = slurp(base + ".txt");
+            if (d.files[2].empty() || GetFileAttributes(d.paths[2].c_str()) == INVALID_FILE_ATTRIBUTES) {
+                buildpack(tests, s[4] == "stdio", s[5], s[6], base + ".tmp");
+                movefile(base + ".tmp", d.paths[2]);
+                d.files[2] = blobname(d.paths[2]);
+                writefile(base + ".tmp", d.files[2].data(), d.files[2].size());
+                movefile(base + ".tmp", base + ".txt");
+            }
+        }
+        for (int k = 0; k < 3; ++k)
+            if (d.files[k].empty())
+                d.files[k] = blobname(d.paths[k]);
+        size_t k = config.rfind('.');
+        d.config  = slurp(config);
+        d.options = slurp((k == string::npos || config.find('\\', k) != string::npos ? config : config.substr(0, k)) + ".opt");
+        d.out     = &out;
+
+        deque<task> tasks; /* Grows while the threads run: a deque keeps their tasks in place. */
+        for (size_t i = 0; i < peers.size(); ++i)
+            if (peers[i]->alive)
+                tasks.pb(task{&d, peers[i].get()});
+        size_t per = max((size_t)1, ids.size() / max((size_t)1, tasks.size() * 4));
+        for (size_t i = 0; i < ids.size(); i += per)
+            d.shards.pb(vector<ui>(ids.begin() + i, ids.begin() + min(ids.size(), i + per)));
+
+        InitializeCriticalSection(&d.cs);
+        vector<HANDLE> threads;
+        for (size_t i = 0; i < tasks.size(); ++i)
+            threads.pb(CreateThread(NULL, 0, serve, &tasks[i], 0, NULL));
+        for (;;) {
+            size_t busy = 0;
+            for (size_t i = 0; i < threads.size(); ++i)
+                busy += WaitForSingleObject(threads[i], 0) == WAIT_TIMEOUT;
+            if (!busy)
+                break;
+            unique_ptr<peer> w = greet(100);
+            if (!w)
+                continue;
+            EnterCriticalSection(&d.cs);
+            peers.pb(move(w));
+            tasks.pb(task{&d, peers.back().get()});
+            LeaveCriticalSection(&d.cs);
+            threads.pb(CreateThread(NULL, 0, serve, &tasks.back(), 0, NULL));
+        }
+        for (size_t i = 0; i < threads.size(); ++i)
+            CloseHandle(threads[i]);
+        DeleteCriticalSection(&d.cs);
+
+        if (!d.error.empty())
+            halt(crash, "Coordinator: " + d.error);
+        if (!d.shards.empty())
+            tolog("Coordinator: No worker is left, the rest of the tests are run here.", LOG_WARN);
+    }
+
+    /* Make *j* (judging with *config*) run its tests on the workers. */
+    void attach (judgecontext& j, const string& config) {
+        j.remote = [this, config](const string& solution, const string& checker, const string& tests,
+                                  const vector<ui>& ids, map<ui, testresult>& out) {
+            judge(config, solution, checker, tests, ids, out);
+        };
+    }
+};
+
+typedef __themisv2_coordinator__ coordinator;
+
+/* What a worker's judging thread gets. */
+struct workerjob {
+    judgecontext* judge;
+    string        error;
+    ui            code;
+};
+
+/* A worker's judging thread. */
+DWORD WINAPI judgejob (LPVOID arg) {
+    workerjob& j = *(workerjob*)arg;
+    j.code = j.judge->run(j.error);
+    return 0;
+}
+
+/* A worker: it connects to the coordinator at *host*:*port*, says hello with the cluster's *key* and runs the jobs it gets, until it is stopped.
+   Files are kept in *store* (ending with '\'), jobs are judged in its subfolder "temp". A lost coordinator is called again every second.
+*/
+void serveworker (const string& host, const string& port, const string& store, const string& key) {
+    netstart();
+    string temp = store + "temp\\", name(256, 0);
+    CreateDirectory(store.c_str(), NULL);
+    CreateDirectory(temp.c_str(), NULL);
+    DWORD n = name.size();
+    name.resize(GetComputerName(&name[0], &n) ? n : 0);
+    name += rfmt("-%d", (int)GetCurrentProcessId());
+
+    for (;; Sleep(1000)) {
+        connection c;
+        if (!c.open(host, port) || !c.sendline("HELLO " + name + " " + key))
+            continue;
+        tolog(rfmt("Worker: Connected to %s:%s.", host.c_str(), port.c_str()));
+        string line;
+        while (c.readline(line)) {
+            int count;
+            string ids;
+            if (sscanf(line.c_str(), "JOB %d", &count) != 1 || !c.readline(ids))
+                break;
+
+            // Get the files it does not have.
+            string files[3];
+            bool ok = 1;
+            for (int k = 0; k < 3 && ok; ++k) {
+                ok = c.readline(line) && !line.compare(0, 5, "FILE ") && line.find_first_of("\\/:", 5) == string::npos;
+                if (!ok)
+                    break;
+                files[k] = store + line.substr(5);
+                if (GetFileAttributes(files[k].c_str()) != INVALID_FILE_ATTRIBUTES) {
+                    ok = c.sendline("HAVE");
+                    continue;
+                }
+                string data, name = line.substr(5);
+                ok = c.sendline("SEND") && c.readblob("DATA", data);
+                if (ok && tohex(fnv(data.data(), data.size())) != name.substr(0, name.find('.'))) {
+                    tolog(rfmt("Worker: File %s does not match its hash.", name.c_str()), LOG_WARN);
+                    ok = 0;
+                }
+                if (ok) {
+                    writefile(files[k] + ".tmp", data.data(), data.size());
+                    movefile(files[k] + ".tmp", files[k]);
+                }
+            }
+            string config, options;
+            if (!ok || !c.readblob("CONFIG", config) || !c.readblob("OPTIONS", options))
+                break;
+
+            // The config with the worker's own files.
+            vector<string> lines = split(config, '\n');
+            if (lines.size() < 8)
+                break;
+            string language = split(lines[2], '.').back();
+            lines[2] = files[0];
+            lines[3] = files[1];
+            lines[7] = files[2];
+            string cfg = temp + "job.cfg";
+            string all = join(lines, '\n');
+            writefile(cfg, all.data(), all.size());
+            writefile(temp + "job.opt", options.data(), options.size());
+
+            // Judge (saying "WAIT" meanwhile), then send the results.
+            judgecontext judge(cfg, temp);
+            judge.prebuilt = 1;
+            judge.language = language;
+            stringstream r(ids);
+            ui id;
+            while (r >> id)
+                judge.only.insert(id);
+            workerjob job = {&judge, "", 0};
+            HANDLE h = CreateThread(NULL, 0, judgejob, &job, 0, NULL);
+            while (WaitForSingleObject(h, __PEER_BEAT__) == WAIT_TIMEOUT)
+                if (ok)
+                    ok = c.sendline("WAIT");
+            CloseHandle(h);
+            for (size_t i = 0; i < judge.results.size() && ok; ++i) {
+                const testresult& t = judge.results[i];
+                string blob = rfmt("%d ", (int)t.id) + ratiotext(t.ratio) + "\n" + t.logs;
+                ok = c.sendblob("RESULT", blob.data(), blob.size());
+            }
+            string done = rfmt("%d\n", job.code) + job.error;
+            if (!ok || !c.sendblob("DONE", done.data(), done.size()))
+                break;
+        }
+        tolog("Worker: Lost the coordinator.", LOG_WARN);
+    }
+}
+
+#endif // __THEMISV2_CLUSTER__
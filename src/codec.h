@@ -0,0 +1,246 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains themisv2's own codec for compressed tests (.thz files).
+**/
+#ifndef __THEMISV2_CODEC__
+#define __THEMISV2_CODEC__
+
+#include "runner.h"
+
+/* .thz form:
+   [header] "THZ1" (4 bytes).
+   [blocks] Each block has its raw length and its compressed length (4 bytes each, little-endian), then the data.
+            If both lengths are equal, the block is stored as it is. A block never holds more than __THZ_BLOCK__ raw bytes.
+   [end]    A block with raw length 0.
+
+   Blocks are compressed with a byte-oriented LZ77 (same idea as LZ4): each sequence is a token
+   (literals' length in the high 4 bits, match's length - 4 in the low 4 bits, 15 means "more bytes follow"),
+   the literals, then the match's offset (2 bytes). The last sequence of a block has literals only.
+   It is fast to decode, so decoding can keep up with a solution reading its input.
+*/
+const char   __THZ_MAGIC__[4] = {'T', 'H', 'Z', '1'};
+const size_t __THZ_BLOCK__    = 1 << 20;
+
+/* Is this file compressed? */
+inline bool isthz (const string& fn) {
+    return fn.size() > 4 && fn.substr(fn.size() - 4) == ".thz";
+}
+
+/* Read and write 4 bytes. */
+inline ui thz_read32 (const unsigned char* p) {
+    ui r;
+    memcpy(&r, p, 4);
+    return r;
+}
+
+inline void thz_write32 (unsigned char* p, ui x) {
+    memcpy(p, &x, 4);
+}
+
+/* Write a length that does not fit in the token. */
+inline void thz_writelen (unsigned char*& op, size_t n) {
+    for (; n >= 255; n -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char)n;
+}
+
+/* Maximum compressed length of *n* raw bytes. */
+inline size_t thz_bound (size_t n) {
+    return n + n / 255 + 16;
+}
+
+/* Compress one block. *dst* must hold thz_bound(n) bytes. Returns the compressed length. */
+size_t thz_compress (const unsigned char* src, size_t n, unsigned char* dst) {
+    const size_t last = 12; // Leave the last bytes as literals so matches never run out of the block.
+    vector<int> table(1 << 16, -1);
+    unsigned char* op = dst;
+    size_t anchor = 0, i = 0;
+
+    while (n >= last && i + last <= n) {
+        ui seq = thz_read32(src + i), h = (seq * 2654435761u) >> 16;
+        int ref = table[h];
+        table[h] = (int)i;
+        if (ref < 0 || i - ref > 65535 || thz_read32(src + ref) != seq) {
+            ++i;
+            continue;
+        }
+
+        // Extend the match.
+        size_t ml = 4;
+        while (i + ml + 5 < n && src[ref + ml] == src[i + ml])
+            ++ml;
+
+        // Emit the sequence.
+        size_t lit = i - anchor;
+        *op++ = (unsigned char)((min(lit, (size_t)15) << 4) | min(ml - 4, (size_t)15));
+        if (lit >= 15)
+            thz_writelen(op, lit - 15);
+        memcpy(op, src + anchor, lit);
+        op += lit;
+        *op++ = (unsigned char)((i - ref) & 255);
+        *op++ = (unsigned char)((i - ref) >> 8);
+        if (ml - 4 >= 15)
+            thz_writelen(op, ml - 4 - 15);
+        i += ml;
+        anchor = i;
+    }
+
+    // Last literals.
+    size_t lit = n - anchor;
+    *op++ = (unsigned char)(min(lit, (size_t)15) << 4);
+    if (lit >= 15)
+        thz_writelen(op, lit - 15);
+    memcpy(op, src + anchor, lit);
+    op += lit;
+    return op - dst;
+}
+
+/* Decompress one block into exactly *n* bytes. Returns 0 if the block is broken. */
+bool thz_decompress (const unsigned char* src, size_t len, unsigned char* dst, size_t n) {
+    const unsigned char *ip = src, *end = src + len;
+    unsigned char *op = dst, *oend = dst + n;
+    while (ip < end) {
+        unsigned token = *ip++;
+
+        // Literals.
+        size_t lit = token >> 4;
+        if (lit == 15)
+            for (unsigned char b = 255; b == 255 && ip < end; lit += b)
+                b = *ip++;
+        if (lit > (size_t)(end - ip) || lit > (size_t)(oend - op))
+            return 0;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == end)
+            break;
+
+        // Match.
+        if (end - ip < 2)
+            return 0;
+        size_t off = ip[0] | (ip[1] << 8), ml = token & 15;
+        ip += 2;
+        if (ml == 15)
+            for (unsigned char b = 255; b == 255 && ip < end; ml += b)
+                b = *ip++;
+        ml += 4;
+        if (!off || off > (size_t)(op - dst) || ml > (size_t)(oend - op))
+            return 0;
+        // Byte by byte: the match may overlap what it is copying.
+        const unsigned char* m = op - off;
+        while (ml--)
+            *op++ = *m++;
+    }
+    return op == oend;
+}
+
+/* A .thz file as a source. Blocks are decoded one by one while the process reads them. */
+class __themisv2_thzsource__ : public __themisv2_source__ {
+private:
+    FILE*                 f;
+    vector<unsigned char> in, out;
+    bool                  first;
+public:
+    __themisv2_thzsource__ (const string& fn): in(thz_bound(__THZ_BLOCK__)), out(__THZ_BLOCK__), first(1) {
+        f = fopen(fn.c_str(), "rb");
+        if (!f)
+            halt(crash, rfmt("Codec: Cannot open \"%s\"!", fn.c_str()));
+    }
+
+    ~__themisv2_thzsource__() {
+        if (f)
+            fclose(f);
+    }
+
+    size_t next (const char*& p) {
+        unsigned char h[8];
+        if (first) {
+            first = 0;
+            if (fread(h, 1, 4, f) != 4 || memcmp(h, __THZ_MAGIC__, 4))
+                halt(crash, "Codec: Not a .thz file!");
+        }
+        if (fread(h, 1, 8, f) != 8)
+            halt(crash, "Codec: Unexpected end of a .thz file!");
+        size_t raw = thz_read32(h), len = thz_read32(h + 4);
+        if (!raw)
+            return 0;
+        if (raw > __THZ_BLOCK__ || len > in.size() || fread(in.data(), 1, len, f) != len)
+            halt(crash, "Codec: Broken .thz block!");
+        if (len == raw)
+            memcpy(out.data(), in.data(), raw);
+        else if (!thz_decompress(in.data(), len, out.data(), raw))
+            halt(crash, "Codec: Broken .thz block!");
+        p = (const char*)out.data();
+        return raw;
+    }
+};
+
+typedef __themisv2_thzsource__ thzsource;
+
+/* Write everything a source gives to a file. */
+void drain (source& s, const string& fn) {
+    FILE* f = fopen(fn.c_str(), "wb");
+    if (!f)
+        halt(crash, rfmt("Codec: Cannot write \"%s\"!", fn.c_str()));
+    const char* p;
+    size_t n;
+    while ((n = s.next(p)) > 0)
+        if (fwrite(p, 1, n, f) != n)
+            halt(crash, rfmt("Codec: Cannot write \"%s\"!", fn.c_str()));
+    fclose(f);
+}
+
+/* Decompress a .thz file to a file. */
+void thz_unpack (const string& src, const string& dst) {
+    tracescope ts("decompress");
+    thzsource s(src);
+    drain(s, dst);
+}
+
+/* Compress a file to a .thz file. Returns the compressed size. */
+ull thz_pack (const string& src, const string& dst) {
+    FILE *f = fopen(src.c_str(), "rb"), *g = fopen(dst.c_str(), "wb");
+    if (!f || !g)
+        halt(crash, "Codec: Cannot open files for compressing!");
+    vector<unsigned char> in(__THZ_BLOCK__), out(thz_bound(__THZ_BLOCK__));
+    unsigned char h[8];
+    ull total = 4;
+    fwrite(__THZ_MAGIC__, 1, 4, g);
+    size_t raw;
+    while ((raw = fread(in.data(), 1, in.size(), f)) > 0) {
+        size_t len = thz_compress(in.data(), raw, out.data());
+        const unsigned char* data = out.data();
+        if (len >= raw)
+            len = raw, data = in.data();
+        thz_write32(h, raw);
+        thz_write32(h + 4, len);
+        fwrite(h, 1, 8, g);
+        fwrite(data, 1, len, g);
+        total += 8 + len;
+    }
+    memset(h, 0, 8);
+    fwrite(h, 1, 8, g);
+    fclose(f);
+    if (fclose(g))
+        halt(crash, "Codec: Cannot write the compressed file!");
+    return total + 8;
+}
+
+#endif // __THEMISV2_CODEC__
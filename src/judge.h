@@ -0,0 +1,1567 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the judge context: everything needed to judge one submission.
+**/
+#ifndef __THEMISV2_JUDGE__
+#define __THEMISV2_JUDGE__
+
+#include "utility.h"
+#include "testpack.h"
+#include "prefetch.h"
+#include "checker.h"
+#include <set>
+
+const ui     __MAX_CHECKERLOG_LINES__ = 3;     /* Max checker's log's number of lines. */
+const double __MAX_SCOREPREC__        = 100.0; /* Max score's precision. */
+const ui     __BATCH_REPLY_LIMIT__    = 30000; /* Longest wait for a batch checker's reply line (ms). */
+
+/* A test between its run and its check (see runtest() and checktest()). */
+struct pendingtest {
+    ui               id;
+    unique_ptr<proc> checker;    /* Its running checker (NULL if the verdict is known without it). */
+    bool             asked;      /* Is it asked to the batch checker instead? */
+    bool             plugged;    /* Or is it checked by the checker plugin? */
+    string           inpath,     /* Where the checker plugin finds the input, the output and the answer. */
+                     outpath,
+                     anspath;
+    string           checkerlog; /* Checker's log. */
+    string           logs;       /* Its logs, written once it is checked so that tests' logs stay in order. */
+    double           result;     /* Its score if it is known without checking. */
+    ull              key;        /* Its key in the result cache (0 if results are not cached). */
+    bool             cached,     /* Is its result from the cache? */
+                     replayed;   /* Or from the journal? */
+
+    pendingtest(): id(0), asked(0), plugged(0), result(0), key(0), cached(0), replayed(0) {}
+};
+
+/* The result of a finished test. */
+struct testresult {
+    ui     id;
+    double ratio; /* Its score over the test's score. */
+    string logs;
+};
+
+/* A score ratio as text, exactly. */
+inline string ratiotext (double p) {
+    char s[32];
+    snprintf(s, sizeof s, "%.17g", p);
+    return s;
+}
+
+/* Remove spaces at both ends. */
+inline string trim (const string& s) {
+    size_t a = s.find_first_not_of(" \t\r"), b = s.find_last_not_of(" \t\r");
+    return a == string::npos ? "" : s.substr(a, b - a + 1);
+}
+
+/* Folder of the running program (ending with '\'). */
+inline string exedir() {
+    char s[1024];
+    DWORD n = GetModuleFileName(NULL, s, sizeof s);
+    string r(s, n);
+    return r.substr(0, r.rfind('\\') + 1);
+}
+
+/* Is the checker of a test run alongside the next test? By default only when solutions have isolated cores
+   (THEMISV2_CORES), so a checker never competes with a timed run for its core.
+*/
+inline bool pipelined() {
+    const char* env = getenv("THEMISV2_PIPELINE");
+    if (env && *env)
+        return string(env) != "0";
+    return !isolation().cores.empty();
+}
+
+/* Folder of the result cache (ending with '\', empty if results are not cached). */
+inline string cachefolder() {
+    const char* env = getenv("THEMISV2_CACHE");
+    return env && *env ? string(env) + string("\\") * (env[strlen(env) - 1] != '\\') : "";
+}
+
+/* Are tests run again even if their results are cached? */
+inline bool freshruns() {
+    const char* env = getenv("THEMISV2_FRESH");
+    return env && string(env) == "1";
+}
+
+/* Is a journal of finished tests kept, so an interrupted judgement can be resumed? */
+inline bool journaled() {
+    const char* env = getenv("THEMISV2_JOURNAL");
+    return !env || string(env) != "0";
+}
+
+/* The problem's options file of a config: the same name with the extension .opt (see readoptions()). */
+inline string optionsfile (const string& config) {
+    size_t k = config.rfind('.');
+    return (k == string::npos || config.find('\\', k) != string::npos ? config : config.substr(0, k)) + ".opt";
+}
+
+/* One of the problem's options of a config, read without checking the others (*def* if it is not given). */
+string problemoption (const string& config, const string& key, const string& def) {
+    ifstream ins(optionsfile(config));
+    string s;
+    while (getline(ins, s)) {
+        s = trim(s);
+        size_t e = s.find('=');
+        if (e != string::npos && s[0] != '#' && trim(s.substr(0, e)) == key)
+            return trim(s.substr(e + 1));
+    }
+    return def;
+}
+
+const ui __SPAWN_RUNS__ = 11; /* Runs of the empty program measuring the spawn overhead. */
+
+/* Spawn overhead: how long (ms) a run of an empty program in *lang* ("cpp" or "pas") takes from its start to its exit,
+   as runs are measured. It is process creation, loading and the language's startup, so it is part of every time used.
+   The median of __SPAWN_RUNS__ runs is kept in *folder*, per machine and language, so it is measured once
+   (again with THEMISV2_FRESH=1). The empty program is built in *temp*. Returns 0 if it cannot be measured.
+*/
+ui spawnoverhead (const string& lang, const string& folder, const string& temp) {
+    tracescope ts("spawn overhead");
+    string host(256, 0);
+    DWORD n = host.size();
+    host.resize(GetComputerName(&host[0], &n) ? n : 0);
+    string fn = folder + "spawn_" + host + "_" + lang + ".txt";
+    ui r;
+    FILE* f;
+    if (!freshruns() && (f = fopen(fn.c_str(), "r")) != NULL) {
+        bool ok = fscanf(f, "%u", &r) == 1;
+        fclose(f);
+        if (ok)
+            return r;
+    }
+
+    string code = lang == "cpp" ? "int main() {}\n" : lang == "pas" ? "begin end.\n" : "";
+    if (code.empty())
+        return 0;
+    string src = temp + "spawn." + lang;
+    writefile(src, code.data(), code.size());
+    string exe = compile(src, temp + "spawnlog.txt");
+    if (exe == "-1" || exe == "!!" || exe == "@@")
+        return 0;
+    vector<ui> times;
+    for (ui i = 0; i < __SPAWN_RUNS__; ++i) {
+        proc a(exe, "", TIME_LIMIT_DEF, inf);
+        ui m, t = TIME_LIMIT_DEF;
+        if (a.run_and_wait_in_time_limit(m, t))
+            return 0;
+        a.stop();
+        times.pb(t);
+    }
+    sort(times.begin(), times.end());
+    r = times[__SPAWN_RUNS__ / 2];
+    string s = to_string(r) + "\n";
+    writefile(fn, s.data(), s.size());
+    return r;
+}
+
+/* A judge context holds all the state of one judgement, so several of them can live in one program.
+
+   USAGE:
+   ------
+   - themisv2.exe makes one context and calls doall(): errors halt the program, as they always did.
+   - A program embedding themisv2 makes one context per submission and calls run() (library mode):
+     errors are returned instead, and logs are kept in the context (see logs).
+     Contexts on different threads can run side by side if each of them has its own temporary folder.
+   A context judges once.
+*/
+class __themisv2_judgecontext__ {
+private:
+    string temp,            /* Temporary folder. */
+           config,          /* Config file. */
+           compilationlog,  /* Compilation log. */
+           scorelog,        /* Score log (used for saving solver's score). */
+           stub_wscode,     /* Stub with source code's file name. */
+           stub_fnr;        /* Stub's replacement sign. */
+
+    string         mode,               /* Problem's mode. */
+                   scoringmode,        /* Scoring mode. */
+                   solution,           /* Solution's destination. */
+                   checker,            /* Checker's destination. */
+                   iomode,             /* Input/Output mode. */
+                   fixed_input,        /* Fixed input form (used in fixedio scoring mode). */
+                   fixed_output,       /* Fixed output form (used in fixedio scoring mode). */
+                   tests,              /* Tests' destination. */
+                   stub;               /* Stub (used in communication problem mode). */
+    ui             time_limit,         /* Time limit. */
+                   mem_limit,          /* Memory limit. */
+                   num_tests,          /* Number of tests counted by verifytests(). */
+                   num_subtasks;       /* Number of counted subtasks. */
+    vector<double> score,              /* Scores of all tests. */
+                   subs;               /* Scores of all subtasks. */
+    vector<ui>     tl,                 /* Time limits of all tests. */
+                   ml,                 /* Memory limits of all tests. */
+                   chksub;             /* Subtask checker. */
+    vector<int>    subtask;            /* Subtask of all tests. */
+    vector<testentry> testlist;        /* Test index built by verifytests(). */
+    testpack       pack;               /* Test pack (if tests' destination is a .pack file). */
+    bool           packed;             /* Are tests packed? */
+    prefetcher     warmer;             /* Prefetcher of tests (runs while compiling). */
+    double         max_score;          /* Maximum score. */
+    bool           subtask_scoring;    /* Use subtask scoring? */
+    map<string, string> options;       /* Problem's options (see readoptions()). */
+    bool           batch;              /* Is the checker a batch checker? */
+    unique_ptr<proc> batchchecker;     /* The batch checker, started at the first check. */
+    bool           plugged,            /* Is the checker a plugin (loaded by themisv2 itself)? */
+                   isolated;           /* Or a plugin loaded by the plugin host, as a batch checker? */
+    bool           exact;              /* Skip the checker when the output is the same as the answer? */
+    ui             reruns,             /* Re-runs of a borderline test (see runtest()). */
+                   band;               /* Borderline band around the time limit, in percent. */
+    bool           median;             /* Take the median time of the runs (or the minimum)? */
+    bool           overhead,           /* Measure the spawn overhead (see spawnoverhead())? */
+                   subtract;           /* And take it off times before comparing them to time limits? */
+    ui             spawn;              /* The spawn overhead in ms (0 if it is not measured). */
+    ui             idle;               /* Idle limit in ms (0 for none). */
+    ui             width,              /* Cores given to a run. */
+                   procs,              /* Most processes of a run at once (0 for no cap). */
+                   sampling;           /* Time between two samples of a run's timeline in ms (0 for no timeline). */
+    HMODULE        plugin;             /* The loaded checker plugin. */
+    checkfn        plugincheck;        /* Its entry point. */
+    string         cachedir;           /* Folder of the result cache (empty if results are not cached). */
+    ull            cachekey;           /* Key of everything but the test in the result cache (see cachekeys()). */
+    string         journal;            /* Journal of finished tests (see readjournal()). */
+    HANDLE         journalh;           /* The journal, open for appending (INVALID_HANDLE_VALUE if there is none). */
+
+    /* Read the problem's options. They are kept next to the config, in a file with the same name and the extension
+       .opt (eg. themisv2.opt for themisv2.cfg). The file is optional.
+       Every line is "<key> = <value>". Empty lines and lines starting with '#' are skipped.
+       ---
+       OPTIONS:
+       checker = normal | batch | plugin | isolated-plugin
+           "batch" if the checker is a batch checker, "plugin" if it is a checker plugin (see checker.h).
+           A plugin runs inside themisv2, unless it is "isolated-plugin": then the plugin host runs it
+           in its own process as a batch checker. Plugins are given as .dll files, not compiled. Default: normal.
+       pluginhost = <destination>
+           The plugin host (tools/pluginhost.cpp). Default: pluginhost.exe next to themisv2.exe.
+       exactmatch = 0 | 1
+           1 to give full score without calling the checker when the output is the same as the answer
+           (see sametext()). Only for checkers that always accept the answer itself. Never used in communication mode. Default: 0.
+       rerun = <k>
+           Run a test *k* more times when its time is borderline, ie. within *rerunband* percent of the time limit. Default: 0.
+       rerunband = <percent>
+           Width of the borderline band, 1 to 100. Default: 5.
+       rerunrule = median | min
+           Time taken from the runs of a borderline test. Default: median.
+       overhead = off | report | subtract
+           "report" to measure the spawn overhead of the solution's language (see spawnoverhead()) and log times
+           without it too, "subtract" to also compare times without it to time limits. Default: off.
+       idlelimit = <ms>
+           Stop a run that uses (almost) no CPU time for this long, eg. waiting for input or sleeping, with the verdict
+           "Idleness limit exceeded" (see proc::idlelimit()). 0 for none. Default: 0.
+       cores = <n>
+           Cores a run is given, for parallel problems: the run holds that many isolated cores (see run isolation)
+           and the dispatcher counts it as that many judgements. Its CPU time and speedup (CPU time / time) are logged.
+           Time limits are still on the time used (wall clock). Default: 1.
+       processes = <n>
+           Most processes a run may have at once, its own included (see proc::parallel()). 0 for no cap. Default: 0.
+       timeline = <ms>
+           Sample the memory and CPU time of every run this often (see proc::sampleevery()) and log its timeline with
+           the test's result, as "<ms>,<KB>,<CPU ms>" samples. 0 for none. Default: 0.
+    */
+    void readoptions() {
+        ifstream ins(optionsfile(config));
+        string s;
+        while (getline(ins, s)) {
+            s = trim(s);
+            if (s.empty() || s[0] == '#')
+                continue;
+            size_t e = s.find('=');
+            if (e == string::npos)
+                halt(crash, rfmt("themisv2: Wrong option \"%s\"!", s.c_str()));
+            options[trim(s.substr(0, e))] = trim(s.substr(e + 1));
+        }
+
+        string c = option("checker", "normal");
+        if (c != "normal" && c != "batch" && c != "plugin" && c != "isolated-plugin")
+            halt(crash, "themisv2: Invalid checker option!");
+        plugged  = c == "plugin";
+        isolated = c == "isolated-plugin";
+        batch    = c == "batch" || isolated;
+
+        string e = option("exactmatch", "0");
+        if (e != "0" && e != "1")
+            halt(crash, "themisv2: Invalid exactmatch option!");
+        exact = e == "1";
+
+        string r = option("rerun", "0"), w = option("rerunband", "5"), m = option("rerunrule", "median");
+        reruns = atoi(r.c_str());
+        band   = atoi(w.c_str());
+        if (r.find_first_not_of("0123456789") != string::npos || reruns > 100)
+            halt(crash, "themisv2: Invalid rerun option!");
+        if (w.find_first_not_of("0123456789") != string::npos || band < 1 || band > 100)
+            halt(crash, "themisv2: Invalid rerunband option!");
+        if (m != "median" && m != "min")
+            halt(crash, "themisv2: Invalid rerunrule option!");
+        median = m == "median";
+
+        string o = option("overhead", "off");
+        if (o != "off" && o != "report" && o != "subtract")
+            halt(crash, "themisv2: Invalid overhead option!");
+        overhead = o != "off";
+        subtract = o == "subtract";
+
+        string d = option("idlelimit", "0");
+        if (d.empty() || d.find_first_not_of("0123456789") != string::npos || d.size() > 9)
+            halt(crash, "themisv2: Invalid idlelimit option!");
+        idle = atoi(d.c_str());
+
+        string n = option("cores", "1"), q = option("processes", "0");
+        width = atoi(n.c_str());
+        procs = atoi(q.c_str());
+        if (n.find_first_not_of("0123456789") != string::npos || width < 1 || width > 64)
+            halt(crash, "themisv2: Invalid cores option!");
+        if (q.find_first_not_of("0123456789") != string::npos || procs > 10000)
+            halt(crash, "themisv2: Invalid processes option!");
+
+        string l = option("timeline", "0");
+        sampling = atoi(l.c_str());
+        if (l.empty() || l.find_first_not_of("0123456789") != string::npos || l.size() > 9)
+            halt(crash, "themisv2: Invalid timeline option!");
+    }
+
+    /* Value of an option (*def* if it is not given). */
+    string option (const string& key, const string& def) {
+        map<string, string>::iterator it = options.find(key);
+        return it == options.end() ? def : it->second;
+    }
+
+    /* Read compilation log. */
+    void readcompilationlog() {
+        tracescope ts("read compilation log");
+        ifstream ins(compilationlog);
+        if (!ins.is_open())
+            halt(crash, "themisv2: There's a problem with the compilation log!");
+        string s;
+        while (getline(ins, s))
+            tolog(s);
+        tolog("---");
+        ins.close();
+    }
+
+    /* Count and verify tests. The index is built by one scan of the tests' folder and cached in a manifest. */
+    void verifytests() {
+        tracescope ts("verify tests");
+        packed = ispack(tests);
+        if (packed) {
+            if (!pack.open(tests))
+                halt(crash, "themisv2: Can't open test pack!");
+            testlist = pack.index();
+        } else
+            testlist = indextests(tests, iomode == "stdio", fixed_input, fixed_output, temp);
+        num_tests = testlist.size();
+    }
+
+    /* Destination of a test's input (ans = 0) or answer (ans = 1) in the tests' folder. */
+    string testfile (const ui& id, bool ans) {
+        return testpath(tests, testlist[id], iomode == "stdio", fixed_input, fixed_output, ans);
+    }
+
+    /* Start warming the page cache with all tests while the solution and the checker compile (then a window ahead of
+       the running test, see prefetcher). Tests of a pack are pieces of it.
+       The config is peeked here (lines 5 to 8) since the real reading only gets to the tests after compiling.
+       A broken config is left for doall() to complain about.
+    */
+    void prefetchtests() {
+        if (!prefetcher::wanted())
+            return;
+        ifstream ins(config);
+        string s[8];
+        for (int i = 0; i < 8; ++i)
+            getline(ins, s[i]);
+        const string &io = s[4], &dir = s[7];
+
+        vector<prefetchpiece> pieces;
+        testpack p;
+        if (ispack(dir)) {
+            if (p.open(dir))
+                for (size_t i = 0; i < p.count(); ++i) {
+                    const packentry& e = p.entry(i);
+                    pieces.pb(prefetchpiece{dir, e.inoff, e.inlen, (ui)i});
+                    pieces.pb(prefetchpiece{dir, e.ansoff, e.anslen, (ui)i});
+                }
+        } else if (io == "stdio" || io == "fixedio") {
+            vector<testentry> r = indextests(dir, io == "stdio", s[5], s[6], temp);
+            for (size_t i = 0; i < r.size(); ++i) {
+                pieces.pb(prefetchpiece{testpath(dir, r[i], io == "stdio", s[5], s[6], 0), 0, 0, (ui)i});
+                pieces.pb(prefetchpiece{testpath(dir, r[i], io == "stdio", s[5], s[6], 1), 0, 0, (ui)i});
+            }
+        }
+        if (!pieces.empty())
+            warmer.start(pieces);
+    }
+
+    /* Write a test's input or answer to *fn*, whether the test is packed, compressed or plain. */
+    void stagetest (const ui& id, bool ans, const string& fn) {
+        if (packed) {
+            mapview v = ans ? pack.answer(id) : pack.input(id);
+            writefile(fn, v.data(), v.size());
+        } else if (ans ? testlist[id].ansz : testlist[id].inz)
+            thz_unpack(testfile(id, ans), fn);
+        else
+            duplicate(testfile(id, ans), fn);
+    }
+
+    /* A test's input as a source for the solution's stdin, so it does not have to be staged first.
+       Packed inputs are served from the mapping (kept alive by *keep*), compressed inputs are decoded while they are read.
+       Plain inputs give NULL.
+    */
+    source* testsource (const ui& id, mapview& keep) {
+        if (packed) {
+            keep = pack.input(id);
+            return new memsource(keep.data(), keep.size());
+        }
+        if (testlist[id].inz)
+            return new thzsource(testfile(id, 0));
+        return NULL;
+    }
+
+    /* Is the output of a test the same as its answer? The answer is read from the pack, the decoder or the tests' folder. */
+    bool sameasanswer (const ui& id, const string& outpath) {
+        tracescope ts("exact match");
+        filemap fo, fa;
+        mapview o, a;
+        string  z;
+        if (fo.open(outpath))
+            o = fo.view(0, (size_t)fo.size());
+        if (packed)
+            a = pack.answer(id);
+        else if (testlist[id].ansz) {
+            thzsource s(testfile(id, 1));
+            const char* p;
+            size_t n;
+            while ((n = s.next(p)) > 0)
+                z.append(p, n);
+        } else if (fa.open(testfile(id, 1)))
+            a = fa.view(0, (size_t)fa.size());
+        else
+            return 0;
+        return testlist[id].ansz ? sametext(o.data(), o.size(), z.data(), z.size())
+                                 : sametext(o.data(), o.size(), a.data(), a.size());
+    }
+
+    /* --- Result cache ---
+       A test's result only depends on the compiled solution, the test, the checker, the limits and how the run is done,
+       so it is kept in the cache folder (THEMISV2_CACHE) keyed by the hashes of all of them. Tests are known by their hashes
+       in the pack, or by their files' paths, sizes and last write times from the test index, so no test is read to key it.
+       That is not their content: a test edited in place with the same size and last write time (eg. a copy keeping its
+       time) gets the stale result, so run such a rejudge with THEMISV2_FRESH=1.
+       How runs are timed is keyed too: the isolated cores and the priority (see isolation()), whether the checker runs
+       alongside the next test (see pipelined()) and where it runs (in themisv2, in the plugin host or as a process).
+       With the overhead option on, times depend on the machine's spawn overhead: the machine and the overhead are keyed too.
+       Binaries are hashed without their link time (see hashbinary()), so compiling the same source again hits the cache. A rejudge after some tests
+       changed only runs the changed tests, the others are answered from the cache with their logs (time and memory included).
+       THEMISV2_FRESH=1 runs every test again (and caches the new results).
+    */
+
+    /* Make the key of everything but the tests (the journal uses it too). Called once the solution and the checker are ready. */
+    void cachekeys() {
+        cachedir = cachefolder();
+        tracescope ts("cache keys");
+        string all = mode + "\n" + iomode + "\n" + fixed_input + "\n" + fixed_output + "\n";
+        for (map<string, string>::iterator it = options.begin(); it != options.end(); ++it)
+            all += it->first + "=" + it->second + "\n";
+        const runisolation& r = isolation();
+        all += "cores=";
+        for (size_t i = 0; i < r.cores.size(); ++i)
+            all += to_string(r.cores[i].cpu) + ",";
+        all += rfmt("\npriority=%d\npipeline=%d\nchecker=%s\n", (int)r.priority, (int)pipelined(),
+                    isolated ? "host" : plugged ? "inside" : batch ? "batch" : "process");
+        if (overhead) {
+            string host(256, 0);
+            DWORD n = host.size();
+            host.resize(GetComputerName(&host[0], &n) ? n : 0);
+            all += "host=" + host + "\nspawn=" + to_string(spawn) + "\n";
+        }
+        ull h[2] = {hashbinary(solution), hashbinary(checker)};
+        cachekey = fnv(h, sizeof h, fnv(all.data(), all.size()));
+    }
+
+    /* Key of a test in the result cache. */
+    ull testkey (const ui& id) {
+        ull h[4] = {0, 0, tl[id], ml[id]};
+        if (packed)
+            h[0] = pack.entry(id).inhash, h[1] = pack.entry(id).anshash;
+        else {
+            const testentry& e = testlist[id];
+            string in  = testfile(id, 0) + "|" + to_string(e.insize) + "|" + to_string(e.inmtime),
+                   ans = testfile(id, 1) + "|" + to_string(e.anssize) + "|" + to_string(e.ansmtime);
+            h[0] = fnv(in.data(), in.size()), h[1] = fnv(ans.data(), ans.size());
+        }
+        return fnv(h, sizeof h, cachekey);
+    }
+
+    /* Cache file of a key. */
+    inline string cachefile (const ull& key) {
+        return cachedir + "res_" + tohex(key) + ".txt";
+    }
+
+    /* Answer a test from the cache. Returns 0 if its result is not cached. */
+    bool cachedresult (const ui& id, pendingtest& t) {
+        ifstream ins(cachefile(t.key));
+        double p;
+        string s;
+        if (!ins.is_open() || !getline(ins, s) || sscanf(s.c_str(), "%lf", &p) != 1)
+            return 0;
+        t.id     = id;
+        t.cached = 1;
+        t.result = score[id] * p;
+        stringstream r;
+        r << ins.rdbuf();
+        t.logs = r.str() + "(Cached result.)\n";
+        return 1;
+    }
+
+    /* Keep the result *x* of a test (with its logs) in the cache. Written under another name first, so nobody reads half of it. */
+    void cacheresult (const pendingtest& t, double x) {
+        string fn = cachefile(t.key), tmp = temp + "res_" + tohex(t.key) + ".tmp";
+        ofstream out(tmp);
+        out << ratiotext(score[t.id] ? x / score[t.id] : 1.0) << "\n" << t.logs;
+        out.close();
+        if (out)
+            movefile(tmp, fn);
+    }
+
+    /* --- Journal ---
+       Every finished test is appended to a journal in the temporary folder (and flushed to the disk), so when themisv2
+       is killed in the middle of a judgement, running it again replays the finished tests (scores, logs, ACM and subtask
+       state all come back through doall()'s finish()) and goes on from the first unfinished one.
+       The journal is only replayed if it was written for the same solution, checker, config and options, and it is
+       deleted once the judgement is done. THEMISV2_JOURNAL=0 turns it off.
+       ---
+       FORMAT:
+       [1st line] "themisv2 journal <key>"
+       [records]  "<test> <score ratio> <length of logs>", then the logs of the test.
+    */
+
+    /* Key of the journal: the config as it is, and everything in the result cache's key. */
+    string journalkey() {
+        ifstream ins(config, ios::binary);
+        stringstream r;
+        r << ins.rdbuf();
+        string c = r.str();
+        return tohex(fnv(c.data(), c.size(), cachekey)) + tohex(num_tests);
+    }
+
+    /* Append a line (and the logs, if any) to the journal and flush it to the disk. */
+    void writejournal (const string& line, const string& logs = "") {
+        string s = line + "\n" + logs;
+        DWORD w;
+        if (!WriteFile(journalh, s.data(), (DWORD)s.size(), &w, NULL) || w != s.size() || !FlushFileBuffers(journalh))
+            halt(crash, "themisv2: Cannot write the journal!");
+    }
+
+    /* Read the journal left by an interrupted judgement of the same submission into *ratio* and *logs* (one per test,
+       from test 0), then start a new journal holding them. A record cut by the interruption is dropped.
+    */
+    void readjournal (vector<double>& ratio, vector<string>& logs) {
+        if (!journaled() || !only.empty())
+            return;
+        tracescope ts("read journal");
+        string key = journalkey(), s;
+        ifstream ins(journal, ios::binary);
+        if (getline(ins, s) && s == "themisv2 journal " + key)
+            while (getline(ins, s)) {
+                ui id;
+                double p;
+                ui n;
+                if (sscanf(s.c_str(), "%u %lf %u", &id, &p, &n) != 3 || id != ratio.size() || id >= num_tests)
+                    break;
+                string l(n, 0);
+                if (n && !ins.read(&l[0], n))
+                    break;
+                ratio.pb(p);
+                logs.pb(l);
+            }
+        ins.close();
+
+        journalh = CreateFile(journal.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (journalh == INVALID_HANDLE_VALUE)
+            halt(crash, "themisv2: Cannot open the journal!");
+        writejournal("themisv2 journal " + key);
+        for (size_t i = 0; i < ratio.size(); ++i)
+            writejournal(rfmt("%d ", (int)i) + ratiotext(ratio[i]) + rfmt(" %d", (int)logs[i].size()), logs[i]);
+    }
+
+    /* Close the journal. It is deleted if the judgement is done. */
+    void closejournal (bool done) {
+        if (journalh == INVALID_HANDLE_VALUE)
+            return;
+        CloseHandle(journalh);
+        journalh = INVALID_HANDLE_VALUE;
+        if (done)
+            DeleteFile(journal.c_str());
+    }
+
+    /* Run the solution once, with time limit *watch*. Returns what run_and_wait_in_time_limit() returns.
+       *contained* (if given) tells whether the run was in a job, ie. whether its memory is the solution's.
+    */
+    ui runsolution (const string& args, ui watch, const string& inpath, const string& outpath, source* src, ui& mem_used, ui& time_used,
+                    bool* contained = NULL) {
+        mem_used  = mem_limit;
+        time_used = watch;
+        proc a(solution, args, watch, mem_limit, inpath, outpath);
+        if (src)
+            a.feed(src);
+        a.idlelimit(idle);
+        a.parallel(width, procs);
+        a.sampleevery(sampling);
+        ui k = a.run_and_wait_in_time_limit(mem_used, time_used);
+        vector<ui> cpus = a.pinnedcpus();
+        string pinned;
+        for (size_t i = 0; i < cpus.size(); ++i)
+            pinned += (i ? "," : "") + to_string(cpus[i]);
+        if (!cpus.empty())
+            tolog(rfmt("Processors: %s --- Context switches: %d", pinned.c_str(), (int)a.contextswitches()), LOG_DEBUG);
+        ui cpu = a.cpuused();
+        tolog(rfmt("CPU time: %d ms --- Speedup: %f", cpu, (double)cpu / max(min(time_used, watch), (ui)1)), width > 1 ? LOG_INFO : LOG_DEBUG);
+        if (sampling) {
+            const vector<runsample>& samples = a.timelineof();
+            string line = "Timeline (ms, KB, CPU ms):";
+            for (size_t i = 0; i < samples.size(); ++i)
+                line += rfmt(" %d,%d,%d", samples[i].at, samples[i].mem, samples[i].cpu);
+            tolog(line);
+        }
+        if (contained)
+            *contained = a.injob();
+        a.stop();
+        return k;
+    }
+
+    /* This function will run a test with *id* and start the checker on it. The checker is waited by checktest().
+       ---
+       If stdout = 0,
+       - Test's name form: <testid>.in for input and <testid>.ans for output.
+       - <testid> starts at 0 and may have any number of leading zeroes, eg. 00.in or 0000.in for input and 00.ans or 0000.ans for output.
+       - While processing, 00.out is solution solver's output.
+       Otherwise,
+       - Test's name form: you give me fixed_input and fixed_output.
+       - The two files must be put in a folder named tests\<testid>.
+       Tests can also be packed (see testpack.h) or compressed (see codec.h). Then the solution reads its input
+       straight from the pack or from the decoder, and test files are only written out when a checker or a stub needs them.
+       ---
+       Two tests in a row use different files (slots 0 and 1), so a test can be checked while the next one runs.
+       Logs of the test are kept in *t* until checktest() is done with it.
+       ---
+       With the overhead option set to "subtract", the spawn overhead is added to the time limit, ie. taken off times.
+       Borderline runs (see the rerun option) are timed with the band above the time limit, so they finish.
+       A run that finishes within the band around the limit is run again, and its time is the median (or the minimum)
+       of all its runs. The output of the fastest run is the one checked. Every run is logged.
+    */
+    void runtest (const ui& id, bool _stdio, const int& _sub, pendingtest& t) {
+        logcapture lc(&t.logs);
+        ui mem_used, time_used;
+        tracescope tt("test");
+        t.id = id;
+
+        tolog(rfmt("\n--- TEST %d%s ---\nCopying ...", id, (rfmt(" (Subtask %d)", _sub) * (_sub >= 0)).c_str()));
+
+        // Where the checker finds the input, the output and the answer.
+        string slot    = temp + "a" + to_string(id & 1);
+        bool   staged  = _stdio || packed || testlist[id].ansz;
+        string inpath  = _stdio ? slot + ".in" : temp + fixed_input,
+               outpath = _stdio ? slot + ".out" : temp + fixed_output,
+               anspath = staged ? slot + ".ans" : testfile(id, 1);
+        t.checkerlog   = temp + "checkerlog" + to_string(id & 1) + ".txt";
+
+        // Copy test files.
+        tracescope tc("copy");
+        mapview keep;
+        unique_ptr<source> src(_stdio && mode != "communication" ? testsource(id, keep) : NULL);
+        if (!src)
+            stagetest(id, 0, inpath);
+        if (mode == "communication" && staged)
+            stagetest(id, 1, anspath);
+
+        tc.end();
+
+        // Run the process.
+        tolog(rfmt("Running ..."));
+        tracescope tr("run");
+        string args  = mode == "communication" ? rfmt("\"%s\" \"%s\"", inpath.c_str(), anspath.c_str()) : "",
+               runin = _stdio && !src ? inpath : "", runout = _stdio ? outpath : "";
+        ui limit = time_limit + spawn * subtract,
+           watch = reruns ? limit + (ull)limit * band / 100 : limit;
+        ui k = runsolution(args, watch, runin, runout, src.get(), mem_used, time_used);
+
+        // Borderline? Run it again.
+        if (!k && reruns && (ull)time_used * 100 > (ull)limit * (100 - band)) {
+            tolog(rfmt("Borderline time (%d ms). Running it %d more times ...", time_used, reruns));
+            string     best = temp + "best" + to_string(id & 1) + ".out";
+            vector<ui> times(1, time_used);
+            ui         fastest = time_used, fastmem = mem_used;
+            movefile(outpath, best);
+            for (ui r = 1; r <= reruns; ++r) {
+                src.reset(_stdio && mode != "communication" ? testsource(id, keep) : NULL);
+                ui mem, ms;
+                k = runsolution(args, watch, runin, runout, src.get(), mem, ms);
+                if (k && k != inf) {
+                    // Not a matter of time anymore: this run's verdict stands.
+                    tolog(rfmt("Run %d: exitcode %d.", r + 1, k));
+                    mem_used = mem, time_used = ms;
+                    break;
+                }
+                ms = k ? watch + 1 : ms;
+                tolog(rfmt("Run %d: %s%d ms", r + 1, (string(">") * !!k).c_str(), min(ms, watch)));
+                times.pb(ms);
+                if (!k && ms < fastest) {
+                    fastest = ms, fastmem = mem;
+                    movefile(outpath, best);
+                }
+            }
+            if (!k || k == inf) {
+                sort(times.begin(), times.end());
+                time_used = median ? times[(times.size() - 1) / 2] : times[0];
+                mem_used  = fastmem;
+                k         = time_used > limit ? inf : 0;
+                tolog(rfmt("Time taken (%s of %d runs): %d ms", median ? "median" : "minimum", (int)times.size(), min(time_used, watch)));
+                if (!k)
+                    movefile(best, outpath);
+            }
+            DeleteFile(best.c_str());
+        }
+
+        tr.end();
+
+        // Some information
+        time_used = min(time_used, limit);
+        tolog(rfmt("Memory used: %d KB --- Time used: %d ms", min(mem_used, mem_limit), time_used)
+              + rfmt(" (%d ms without the spawn overhead)", max(time_used, spawn) - spawn) * overhead);
+
+        // Check some cases.
+        tolog("Checking answer ...");
+        if (k == inf) {
+            tolog("Verdict: Time limit exceeded!");
+            return;
+        }
+        if (k == inf * 2) {
+            tolog("Verdict: Memory limit exceeded!");
+            return;
+        }
+        if (k == 3u * inf) {
+            tolog("Verdict: Idleness limit exceeded!");
+            return;
+        }
+        if (k != 0) {
+            tolog(rfmt("Verdict: Runtime error! Process returned exitcode %d.", k));
+            return;
+        }
+
+        // The next test needs the fixed names, so this one's files are moved to its slot.
+        if (!_stdio) {
+            movefile(inpath, slot + "_" + fixed_input);
+            movefile(outpath, slot + "_" + fixed_output);
+            inpath  = slot + "_" + fixed_input;
+            outpath = slot + "_" + fixed_output;
+        }
+
+        // Same as the answer? Then there is nothing to check.
+        if (exact && mode != "communication" && sameasanswer(id, outpath)) {
+            tolog("Verdict: Accepted! (Same as the answer.)");
+            t.result = score[id];
+            return;
+        }
+
+        // Start the checker.
+        tracescope tk("start checker");
+        if (plugged && packed) {
+            // The plugin reads the input and the answer straight from the pack.
+            t.plugged = 1;
+            t.outpath = outpath;
+            return;
+        }
+        if (src)
+            stagetest(id, 0, inpath);
+        if (mode != "communication" && staged)
+            stagetest(id, 1, anspath);
+        if (plugged) {
+            t.plugged = 1;
+            t.inpath  = inpath;
+            t.outpath = outpath;
+            t.anspath = anspath;
+            return;
+        }
+        if (batch) {
+            if (!batchchecker) {
+                if (isolated)
+                    batchchecker.reset(new proc(option("pluginhost", exedir() + "pluginhost.exe"), rfmt("\"%s\" --batch", checker.c_str()), inf, inf));
+                else
+                    batchchecker.reset(new proc(checker, "--batch", inf, inf));
+                batchchecker->talk();
+                batchchecker->start();
+            }
+            if (!batchchecker->writeline(inpath) || !batchchecker->writeline(outpath) || !batchchecker->writeline(anspath))
+                halt(crash, "themisv2: Batch checker: It stopped listening!");
+            t.asked = 1;
+            return;
+        }
+        t.checker.reset(new proc(checker, rfmt("\"%s\" \"%s\" \"%s\"", inpath.c_str(), outpath.c_str(), anspath.c_str()), inf, inf, "", t.checkerlog, ""));
+        t.checker->start();
+    }
+
+    /* Log the verdict and the comment given by a batch checker or a plugin. Returns the test's score. */
+    double verdict (const pendingtest& t, double p, const vector<string>& comment) {
+        if (p < 0 || p > 1)
+            halt(crash, "themisv2: Given score is not in range [0, 1]");
+        tolog(rfmt("Verdict: %s", p < 1 ? "Bad Answer!" : "Accepted!"));
+
+        // Only the first lines of the comment are given (see checktest()).
+        tolog("Checker logs\n---");
+        for (size_t i = 0; i < comment.size() && i + 2 < __MAX_CHECKERLOG_LINES__; ++i)
+            tolog(comment[i]);
+        tolog("---");
+
+        return score[t.id] * p;
+    }
+
+    /* Read a line of the batch checker's reply. A checker that stops replying (eg. looping) halts the judgement. */
+    bool replyline (string& s) {
+        if (batchchecker->readline(s, __BATCH_REPLY_LIMIT__))
+            return 1;
+        if (batchchecker->opening())
+            halt(crash, rfmt("themisv2: Batch checker: No reply in %d ms!", __BATCH_REPLY_LIMIT__));
+        return 0;
+    }
+
+    /* Get the batch checker's reply for a test. Replies come in the order tests were asked. */
+    double checkbatch (pendingtest& t) {
+        logcapture lc(&t.logs);
+        tracescope tk("check");
+        string s;
+        double p;
+        int n;
+        if (!replyline(s) || sscanf(s.c_str(), "%lf %d", &p, &n) != 2 || n < 0)
+            halt(crash, "themisv2: Batch checker: Wrong reply!");
+        vector<string> comment(n);
+        for (int i = 0; i < n; ++i)
+            if (!replyline(comment[i]))
+                halt(crash, "themisv2: Batch checker: Wrong reply!");
+        tk.end();
+        return verdict(t, p, comment);
+    }
+
+    /* Check a test with the checker plugin, on mapped files (or straight on the pack). A missing file is empty. */
+    double checkplugin (pendingtest& t) {
+        logcapture lc(&t.logs);
+        tracescope tk("check");
+        filemap f[3];
+        mapview v[3];
+        string  fn[3] = {t.inpath, t.outpath, t.anspath};
+        for (int k = 0; k < 3; ++k)
+            if (packed && k != 1)
+                v[k] = k ? pack.answer(t.id) : pack.input(t.id);
+            else if (f[k].open(fn[k]))
+                v[k] = f[k].view(0, (size_t)f[k].size());
+
+        char msg[4096] = "";
+        double p = plugincheck(v[0].data(), v[0].size(), v[1].data(), v[1].size(), v[2].data(), v[2].size(), msg, sizeof msg);
+        msg[sizeof msg - 1] = 0; // Whatever the plugin left there.
+        if (p < 0)
+            halt(crash, rfmt("themisv2: Checker plugin: %s", msg));
+        tk.end();
+        return verdict(t, p, *msg ? split(msg, '\n') : vector<string>());
+    }
+
+    /* Wait for the checker of a test run by runtest() and read its log. A score for the test will be returned. */
+    double checktest (pendingtest& t) {
+        if (!t.checker && !t.asked && !t.plugged)
+            return t.result;
+        if (t.asked)
+            return checkbatch(t);
+        if (t.plugged)
+            return checkplugin(t);
+        logcapture lc(&t.logs);
+        tracescope tk("check");
+        ui k = t.checker->wait();
+        t.checker->stop();
+        t.checker.reset();
+        tk.end();
+        tolog(rfmt("Verdict: %s", k ? "Bad Answer!" : "Accepted!"));
+
+        // Read checker log and score.
+        tracescope tg("read checker log");
+        tolog("Checker logs\n---");
+        ifstream ins(t.checkerlog);
+        string s;
+        double p = 0;
+        ui lines = 0;
+        while (++lines < __MAX_CHECKERLOG_LINES__ && getline(ins, s)) {
+            if (lines == 1) {
+                stringstream r(s);
+                r >> p;
+                if (p < 0 || p > 1)
+                    halt(crash, "themisv2: Given score is not in range [0, 1]");
+            } else
+                tolog(s);
+        }
+        ins.close();
+        tolog("---");
+
+        return score[t.id] * p;
+    }
+
+    /* Write the logs kept for a test. */
+    void flushlogs (string& logs) {
+        if (!logs.empty() && logs[logs.size() - 1] == '\n')
+            logs.erase(logs.size() - 1);
+        if (!logs.empty())
+            tolog(logs);
+        logs = "";
+    }
+
+    /* Compile the solution. */
+    ui compilesolution (bool _stub = 0) {
+        tracescope ts("compile solution");
+        tolog(rfmt("Processing %s ...", _stub ? "stub" : split(solution, '\\').back().c_str()));
+        solution = compile(solution, compilationlog);
+        if (solution == "@@") {
+            tolog("Too large solution file!");
+            return TBS;
+        }
+        if (solution == "!!") {
+            tolog("Unsupported language!");
+            return UKNL;
+        }
+        if (solution == "-1") {
+            tolog("Compilation error!\nLogs\n---");
+            readcompilationlog();
+            return CE;
+        }
+        return 0;
+    }
+public:
+    double main_score; /* Score of the submission (once judged). */
+    string logs;       /* Logs of the judgement (library mode only). */
+    vector<testresult> results; /* Result of every finished test, in order. */
+
+    /* Set before judging: */
+    set<ui> only;      /* Judge only these tests (all of them if it is empty). Others get no result and no score. */
+    bool    prebuilt;  /* Are the solution and the checker (lines 3 and 4 of the config) given compiled? */
+    string  language;  /* The solution's language ("cpp" or "pas"), found by its extension unless it is prebuilt. */
+
+    /* Called once everything is ready, to run the tests in *ids* somewhere else (see cluster.h). The results it gives
+       are scored as if the tests were run here; tests it gives no result for are run here.
+       Its arguments are the compiled solution, the checker, the tests' destination and the tests to run.
+    */
+    function<void(const string&, const string&, const string&, const vector<ui>&, map<ui, testresult>&)> remote;
+
+    /* A context judging with *_config* in the temporary folder *_temp* (ending with '\'). */
+    __themisv2_judgecontext__ (const string& _config, const string& _temp) {
+        config         = _config;
+        temp           = _temp;
+        compilationlog = temp + "compilationlog.txt";
+        scorelog       = temp + "score.txt";
+        stub_wscode    = temp + "solutionwithstub.";
+        stub_fnr       = "// Your code goes here";
+        time_limit = mem_limit = num_tests = num_subtasks = 0;
+        journal        = temp + "journal.txt";
+        packed = subtask_scoring = batch = plugged = isolated = exact = median = overhead = subtract = 0;
+        reruns = band = spawn = idle = procs = sampling = 0;
+        width  = 1;
+        cachekey    = 0;
+        journalh    = INVALID_HANDLE_VALUE;
+        prebuilt    = 0;
+        plugin      = NULL;
+        plugincheck = NULL;
+        max_score = main_score = 0;
+    }
+
+    ~__themisv2_judgecontext__() {
+        closejournal(0);
+        batchchecker.reset();
+        if (plugin)
+            FreeLibrary(plugin);
+    }
+
+    /* themisv2's config will have the form:
+       [1st line]  <problem mode> ("normal", "communication")
+       [2nd line]  <scoring mode> ("normal", "ACM")
+       [3st line]  <solution's destination>
+       [4th line]  <checker's destination>
+       [5th line]  <i/o mode> ("stdio", "fixedio")
+       [6th line]  <fixed_input> (if <scoring mode> is "fixedio", otherwise leave it blank)
+       [7th line]  <fixed_output> (if <scoring mode> is "fixedio", otherwise leave it blank)
+       [8th line]  <tests' destination>
+       [9th line]  <tests' strength>
+       [10th line] <max score>
+       [11st line] <time limit>
+       [12nd line] <memory limit>
+       [13rd line] <stub's destination> (if you are using communication problems, otherwise leave it blank)
+       [14th line] <subtask> (if you want to use subtask-scoring)
+       [last line] <subtasks' strength> (if you want to use subtask-scoring)
+       ---
+       <fixed_input> should only contains the input file name, eg. THEMISV2.INP.
+       <fixed_output> should only contains the output file name, eg. THEMISV2.OUT.
+       <tests' strength> begin with an integer *n* specifying the number of judger's tests. *n* following integers, split by spaces, are tests' strength (must be greater than 1).
+       <time limit> is same as <strength> and so are <memory limit> and <subtask>. All the four must have the same first integer *n*.
+       <subtasks' strength> starts with an integer *m* specifying the number of subtasks. The rest are same as <tests' strength>.
+       All the unneeded lines must be left blank.
+       ---
+       [ACCEPTED]
+       The solution can only be assumed as "passed" a test iff it has the number "1" returned from checker.
+       Please note this or you (judger) will mischeck sometimes.
+       ---
+       [CHECKER'S LOG]
+       Your checker's stdout must be printed as follows:
+       + The first line contains only ONE real number in the range [0, 1], the percent of score problem solver have for the answer.
+       + From the second line to EOF, your comment (this will be given to the problem solver).
+       I only give to the problem solver the __MAX_CHECKERLOG_LINES__ first lines of your comment so it should be short!
+       ---
+       [COMMUNICATION MODE]
+       ** Stub and solution must have the same language so you (judger) should prepare stubs for all languages.
+       Your stub and checker will have to communicate with each other through your stub's output:
+       + In "stdio" mode, your stub's output should be stdout.
+       + In "fixedio" mode, your stub's output should be <fixed_output>.
+       I will use the last result on checker's stdout to determine score and log.
+       ---
+       [SUBTASK SCORING]
+       If you want to use this additional scoring mode, you must give us a sequence of *n* integers that defines which tests should belong to a subtask.
+       Your subtask(s) must be numbered by a sequence that starts at 0 and increase by 1 at each step, eg. 0, 1, 2, 3, ...
+       Note that, if you have already set your scoring mode to "ACM", subtask scoring will not work!
+    */
+    ui doall() {
+        ifstream ins(config);
+        ofstream result(scorelog);
+        if (!ins.is_open())
+            halt(crash, "themisv2: Can't find config file!");
+        tracescope ts("doall");
+
+        /** Everything starts here! **/
+
+        // Get Date and Time.
+        tolog(rfmt("[%s]", dt().c_str()));
+
+        // Get the problem's options.
+        readoptions();
+
+        // Warm tests up while compiling.
+        prefetchtests();
+
+        // Get problem mode.
+        if (!getline(ins, mode))
+            halt(crash, "themisv2: Unable to get problem mode!");
+        if (mode != "normal" && mode != "communication")
+            halt(crash, "themisv2: Invalid problem mode!");
+        tolog(rfmt("Problem mode: %s", mode.c_str()));
+
+        // Get scoring mode.
+        if (!getline(ins, scoringmode))
+            halt(crash, "themisv2: Unable to get scoring mode!");
+        if (scoringmode != "normal" && scoringmode != "ACM")
+            halt(crash, "themisv2: Invalid scoring mode!");
+        tolog(rfmt("Scoring mode: %s", scoringmode.c_str()));
+
+        // Get solution's destination.
+        if (!getline(ins, solution))
+            halt(crash, "themisv2: Unable to get solution's destination!");
+        if (!prebuilt)
+            language = split(solution, '.').back();
+
+        // Copy the solution to temp folder.
+        if (!prebuilt) {
+            tolog("Preparing solution ...");
+            duplicate(solution, temp + split(solution, '\\').back());
+            solution = temp + split(solution, '\\').back();
+        }
+
+        // Set stub language.
+        if (mode == "communication")
+            stub_wscode += split(solution, '.').back();
+
+        // Compile the solution.
+        if (mode == "normal" && !prebuilt) {
+            tolog("Compiling solution ...");
+            ui ret = compilesolution();
+            if (ret)
+                return ret;
+        }
+
+        // Get checker's destination.
+        if (!getline(ins, checker))
+            halt(crash, "themisv2: Unable to get checker's destination!");
+
+        // Load the checker plugin.
+        tracescope tk("compile checker");
+        if (plugged || isolated) {
+            tolog("Preparing checker plugin ...");
+            if (checker.size() < 4 || checker.substr(checker.size() - 4) != ".dll")
+                halt(crash, "themisv2: Checker: A checker plugin must be a .dll file!");
+            if (plugged) {
+                if (!(plugin = LoadLibrary(checker.c_str())))
+                    halt(crash, "themisv2: Checker: Cannot load the checker plugin!");
+                if (!(plugincheck = (checkfn)GetProcAddress(plugin, "check")))
+                    halt(crash, "themisv2: Checker: The checker plugin has no check()!");
+            }
+        } else if (!prebuilt) {
+            // Copy the checker to temp folder.
+            tolog("Preparing checker ...");
+            duplicate(checker, temp + split(checker, '\\').back());
+            checker = temp + split(checker, '\\').back();
+
+            // Compile the checker.
+            tolog("Compiling checker ...");
+            checker = compile(checker, compilationlog);
+            if (checker == "@@")
+                halt(crash, "themisv2: Checker: Too large checker source code!");
+            if (checker == "!!")
+                halt(crash, "themisv2: Checker: Unsupported language!");
+            if (checker == "-1") {
+                tolog("Logs\n---");
+                readcompilationlog();
+                halt(crash, "themisv2: Checker: Compilation error!");
+            }
+        }
+        tk.end();
+
+        // Get scoring mode.
+        if (!getline(ins, iomode))
+            halt(crash, "themisv2: Unable to get scoring mode!");
+        if (iomode != "stdio" && iomode != "fixedio")
+            halt(crash, "themisv2: Unsupported scoring mode!");
+        tolog(rfmt("I/O mode: %s", iomode.c_str()));
+
+        // Get fixed_input and fixed_output.
+        if (!getline(ins, fixed_input))
+            if (iomode == "fixedio")
+                halt(crash, "themisv2: Unable to get fixed_input!");
+        if (!getline(ins, fixed_output))
+            if (iomode == "fixedio")
+                halt(crash, "themisv2: Unable to get fixed_output!");
+
+        // Get tests' destination.
+        if (!getline(ins, tests))
+            halt(crash, "themisv2: Unable to get tests' destination!");
+        verifytests();
+        if (!num_tests)
+            halt(crash, "themisv2: No vaild test found!");
+
+        // Get tests' strength.
+        ui n;
+        string tmp;
+        if (!getline(ins, tmp))
+            halt(crash, "themisv2: Unable to get tests' strength!");
+        if (tmp.empty())
+            halt(crash, "themisv2: Unable to get tests' strength!");
+        stringstream r(tmp);
+        r >> n;
+
+        // Conflict numbers of tests.
+        if (n != num_tests)
+            halt(crash, "themisv2: Number of verified tests is different from your number of tests!");
+
+        for (size_t i = 0; i < n; ++i) {
+            double x;
+            if (!(r >> x))
+                halt(crash, "themisv2: Invaild number of tests!");
+            score.pb(x);
+        }
+
+        // Get max score.
+        if (!getline(ins, tmp))
+            halt(crash, "themisv2: Unable to get max score!");
+        if (tmp.empty())
+            halt(crash, "themisv2: Unable to get max score!");
+        r.str(tmp);
+        r.seekg(0);
+        r >> max_score;
+
+        // Get time limits.
+        tolog("Getting time limits ...");
+        if (!getline(ins, tmp))
+            halt(crash, "themisv2: Unable to get time limits!");
+        if (tmp.empty())
+            halt(crash, "themisv2: Unable to get time limits!");
+        r.str(tmp);
+        r.seekg(0);
+        r >> n;
+
+        // Conflict numbers of tests.
+        if (n != num_tests)
+            halt(crash, "themisv2: Number of verified tests is different from your number of tests!");
+
+        for (size_t i = 0; i < n; ++i) {
+            ui x;
+            if (!(r >> x))
+                halt(crash, "themisv2: Invaild number of tests!");
+            tl.pb(x);
+        }
+
+        // Get memory limits.
+        tolog("Getting memory limits ...");
+        if (!getline(ins, tmp))
+            halt(crash, "themisv2: Unable to get memory limits!");
+        if (tmp.empty())
+            halt(crash, "themisv2: Unable to get memory limits!");
+        r.str(tmp);
+        r.seekg(0);
+        r >> n;
+
+        // Conflict numbers of tests.
+        if (n != num_tests)
+            halt(crash, "themisv2: Number of verified tests is different from your number of tests!");
+
+        for (size_t i = 0; i < n; ++i) {
+            ui x;
+            if (!(r >> x))
+                halt(crash, "themisv2: Invaild number of tests!");
+            ml.pb(x);
+        }
+
+        // Get stub's destination.
+        if (!getline(ins, stub) && mode == "communication")
+            halt(crash, "themisv2: Communication problem must have stub!");
+
+        // Copy the stub to temp folder.
+        if (mode == "communication" && !prebuilt) {
+            tolog("Preparing stub ...");
+            duplicate(stub, temp + split(stub, '\\').back());
+            stub = temp + split(stub, '\\').back();
+        }
+
+        // Replace and compile.
+        if (mode == "communication" && !prebuilt) {
+            if (!fnr(stub_wscode, stub, solution, stub_fnr))
+                halt(crash, "themisv2: Wrong stub's form!");
+
+            // Compile the solution (with stub).
+            tolog("Compiling solution (with stub) ...");
+            solution = stub_wscode;
+            ui ret   = compilesolution();
+            if (ret)
+                return ret;
+        }
+
+        // Get subtask scoring.
+        if (scoringmode == "normal") {
+            tolog("Getting subtask scoring ...");
+            if (!getline(ins, tmp))
+                halt(crash, "themisv2: Unable to get subtask scoring!");
+            subtask_scoring = !tmp.empty();
+            if (subtask_scoring)
+                tolog("Additional mode: Subtask-scoring is ON");
+
+            if (subtask_scoring) {
+                r.str(tmp);
+                r.seekg(0);
+                r >> n;
+
+                // Conflict numbers of tests.
+                if (n != num_tests)
+                    halt(crash, "themisv2: Number of verified tests is different from your number of tests!");
+
+                set<int> w;
+                for (size_t i = 0; i < n; ++i) {
+                    ui x;
+                    if (!(r >> x))
+                        halt(crash, "themisv2: Invaild number of tests!");
+                    chksub.pb(x);
+                    w.insert(x);
+                }
+
+                // Check if set *w* is an increasing sequence 0, 1, 2, ... or not.
+                int bg = -1;
+                for (set<int>::iterator it = w.begin(); it != w.end(); ++it) {
+                    if ((*it - bg) != 1)
+                        halt(crash, "themisv2: Wrong subtask form!");
+                    bg = *it;
+                    subtask.pb(1);
+                }
+                num_subtasks = w.size();
+            }
+        }
+
+        // Get subtasks' scores.
+        if (subtask_scoring) {
+            tolog("Getting subtasks' scores ...");
+            if (!getline(ins, tmp))
+                halt(crash, "themisv2: Unable to get subtasks' scores!");
+            if (tmp.empty())
+                halt(crash, "themisv2: Unable to get subtasks' scores!");
+            r.str(tmp);
+            r.seekg(0);
+            r >> n;
+
+            // Conflict numbers of tests.
+            if (n != num_subtasks)
+                halt(crash, "themisv2: Number of counted subtasks is different from your number of subtasks!");
+
+            for (size_t i = 0; i < n; ++i) {
+                ui x;
+                if (!(r >> x))
+                    halt(crash, "themisv2: Invaild number of subtasks!");
+                subs.pb(x);
+            }
+            subs = scoring(max_score, subs);
+        }
+
+        // Measure the spawn overhead.
+        if (overhead) {
+            string folder = cachefolder();
+            spawn = spawnoverhead(language, folder.empty() ? temp : folder, temp);
+            tolog(rfmt("Spawn overhead: %d ms", spawn));
+        }
+
+        // If everything's OK, run all tests.
+        bool err = 0; // Error checker
+        score = scoring(max_score, score);
+        main_score = 0;
+        tolog(rfmt("Prefetched %f MB of tests before the first one.", warmer.finish() / 1048576.0));
+        cachekeys();
+        bool fresh = freshruns();
+
+        // Resume an interrupted judgement.
+        vector<double> ratio;
+        vector<string> done;
+        readjournal(ratio, done);
+        if (!ratio.empty())
+            tolog(rfmt("Resuming after test %d (from the journal) ...", (int)ratio.size() - 1));
+
+        // Run tests somewhere else.
+        map<ui, testresult> given;
+        if (remote) {
+            vector<ui> ids;
+            for (ui i = ratio.size(); i < num_tests; ++i)
+                if (only.empty() || only.count(i))
+                    ids.pb(i);
+            tracescope td("remote");
+            remote(solution, checker, tests, ids, given);
+        }
+
+        // Check a test, then write its logs and score it. Returns 1 if judging should stop here.
+        auto finish = [&](pendingtest& t) -> bool {
+            __tracer__.settest(t.id);
+            double x = checktest(t);
+            __tracer__.settest(-1);
+            double p = score[t.id] ? x / score[t.id] : 1.0;
+            if (t.key && !t.cached && !t.replayed)
+                cacheresult(t, x);
+            if (journalh != INVALID_HANDLE_VALUE && !t.replayed)
+                writejournal(rfmt("%d ", t.id) + ratiotext(p) + rfmt(" %d", (int)t.logs.size()), t.logs);
+            results.pb(testresult{t.id, p, t.logs});
+            flushlogs(t.logs);
+            main_score += x;
+
+            // Fails one test in "ACM" scoring mode.
+            if (x < score[t.id] && scoringmode == "ACM")
+                return err = 1;
+
+            // Subtask-scoring.
+            if (scoringmode == "normal" && subtask_scoring)
+                subtask[chksub[t.id]] &= (x == score[t.id]);
+            return 0;
+        };
+
+        // Test i is checked while test i + 1 runs, on other cores (see pipelined()). Only one solution runs at a time.
+        bool pipeline = pipelined();
+        unique_ptr<pendingtest> prev;
+        tracescope tr("run tests");
+        for (ui i = 0; i < num_tests; ++i) {
+            if (!only.empty() && !only.count(i))
+                continue;
+            time_limit  = tl[i];
+            mem_limit   = ml[i];
+            unique_ptr<pendingtest> now(new pendingtest);
+            __tracer__.settest(i);
+            warmer.advance(i);
+            if (!cachedir.empty())
+                now->key = testkey(i);
+            if (i < ratio.size()) {
+                now->id       = i;
+                now->replayed = 1;
+                now->result   = score[i] * ratio[i];
+                now->logs     = done[i];
+            } else if (given.count(i)) {
+                now->id     = i;
+                now->result = score[i] * given[i].ratio;
+                now->logs   = given[i].logs;
+            } else if (!now->key || fresh || !cachedresult(i, *now))
+                runtest(i, iomode == "stdio", subtask_scoring ? (int)chksub[i] : -1, *now);
+            __tracer__.settest(-1);
+
+            // If the previous test stops judging, this one was run for nothing and is dropped.
+            if (prev && finish(*prev)) {
+                prev.reset();
+                break;
+            }
+            if (pipeline)
+                prev = move(now);
+            else if (finish(*now))
+                break;
+        }
+        if (prev)
+            finish(*prev);
+        batchchecker.reset();
+
+        tr.end();
+
+        // Recalculate score for subtask-scoring.
+        if (scoringmode == "normal" && subtask_scoring) {
+            main_score = 0;
+            for (ui i = 0; i < num_subtasks; ++i)
+                main_score += subtask[i] * subs[i];
+        }
+
+        // Write logs.
+        tolog(rfmt("\n---> Your score: %f/%f", round(main_score * __MAX_SCOREPREC__) / __MAX_SCOREPREC__, max_score));
+
+        // Write scores.
+        result << main_score << endl;
+
+        /** Everything stops here! **/
+
+        ins.close();
+        result.close();
+        closejournal(1);
+
+        return err;
+    }
+
+    /* Judge in library mode. Returns the same exitcodes as themisv2.exe does (see main()),
+       with the message of the error (if any) in *error*. The temporary folder is made if needed.
+    */
+    ui run (string& error) {
+        bool    throws  = __halt_throws__;
+        string* capture = __logcapture__;
+        __halt_throws__ = 1;
+        __logcapture__  = &logs;
+
+        ui r;
+        error = "";
+        try {
+            CreateDirectory(temp.c_str(), NULL);
+            r = doall();
+        } catch (const judgeerror& e) {
+            r     = e.code;
+            error = e.message;
+        }
+
+        __halt_throws__ = throws;
+        __logcapture__  = capture;
+        return r;
+    }
+
+    /* Calibration: derive the time and memory limits (lines 11 and 12 of the config) from reference solutions.
+       Every reference is compiled and run *runs* times on every test, timed as judged runs are (so with the run
+       isolation, if any, and the problem's options), with *cap* ms and no memory limit. With the overhead option set to
+       "subtract", times are taken without the spawn overhead, as they are compared to time limits. Borderline re-runs
+       do not apply: every run counts. A test's time limit is the slowest time times *factor*, rounded up to 10 ms;
+       its memory limit is the largest peak times *memfactor*, rounded up to 1 MB.
+       The two lines of the config are then rewritten (memory limits only if every run's memory was the solution's,
+       see proc::memused()). The references must pass every test in time: nothing is
+       checked but their exitcodes. Normal problems only. Returns 0, or the compilation error of a reference.
+    */
+    ui calibrate (const vector<string>& refs, ui runs, ui cap, double factor, double memfactor) {
+        tracescope ts("calibrate");
+        ifstream ins(config);
+        if (!ins.is_open())
+            halt(crash, "themisv2: Can't find config file!");
+        vector<string> lines;
+        string s;
+        while (getline(ins, s))
+            lines.pb(s);
+        ins.close();
+        if (lines.size() < 12)
+            lines.resize(12);
+
+        readoptions();
+        mode         = lines[0];
+        iomode       = lines[4];
+        fixed_input  = lines[5];
+        fixed_output = lines[6];
+        tests        = lines[7];
+        if (mode != "normal")
+            halt(crash, "themisv2: Calibration: Only normal problems can be calibrated!");
+        if (iomode != "stdio" && iomode != "fixedio")
+            halt(crash, "themisv2: Unsupported scoring mode!");
+        verifytests();
+        if (!num_tests)
+            halt(crash, "themisv2: No vaild test found!");
+
+        bool _stdio = iomode == "stdio";
+        string inpath  = _stdio ? temp + "a0.in" : temp + fixed_input,
+               outpath = _stdio ? temp + "a0.out" : temp + fixed_output;
+        vector<vector<ui> > times(num_tests);
+        vector<ui>          mems(num_tests, 0);
+        bool                solutionmem = 1;
+        mem_limit = inf;
+        for (size_t j = 0; j < refs.size(); ++j) {
+            solution = temp + split(refs[j], '\\').back();
+            language = split(solution, '.').back();
+            duplicate(refs[j], solution);
+            ui ret = compilesolution();
+            if (ret)
+                return ret;
+            if (overhead) {
+                string folder = cachefolder();
+                spawn = spawnoverhead(language, folder.empty() ? temp : folder, temp);
+                tolog(rfmt("Spawn overhead: %d ms", spawn));
+            }
+            for (ui i = 0; i < num_tests; ++i) {
+                mapview keep;
+                unique_ptr<source> src(testsource(i, keep));
+                if (!src)
+                    stagetest(i, 0, inpath);
+                for (ui r = 0; r < runs; ++r) {
+                    if (r)
+                        src.reset(testsource(i, keep));
+                    ui   mem, ms;
+                    bool contained;
+                    ui   k = runsolution("", cap, _stdio && !src ? inpath : "", _stdio ? outpath : "", src.get(), mem, ms, &contained);
+                    if (k == inf)
+                        halt(crash, rfmt("themisv2: Calibration: %s exceeds %d ms on test %d!", refs[j].c_str(), cap, i));
+                    if (k)
+                        halt(crash, rfmt("themisv2: Calibration: %s returns exitcode %d on test %d!", refs[j].c_str(), k, i));
+                    times[i].pb(subtract ? max(ms, spawn) - spawn : ms);
+                    mems[i] = max(mems[i], mem);
+                    solutionmem &= contained;
+                }
+            }
+        }
+
+        string tline = to_string(num_tests), mline = tline;
+        for (ui i = 0; i < num_tests; ++i) {
+            sort(times[i].begin(), times[i].end());
+            ui t = max((ui)10, (ui)ceil(times[i].back() * factor / 10) * 10),
+               m = max((ui)1024, (ui)ceil(mems[i] * memfactor / 1024) * 1024);
+            tolog(rfmt("Test %d: %d / %d / %d ms (min / median / max), %d KB --- Limits: %d ms, %d KB",
+                       i, times[i][0], times[i][(times[i].size() - 1) / 2], times[i].back(), mems[i], t, m));
+            tline += " " + to_string(t);
+            mline += " " + to_string(m);
+        }
+        lines[10] = tline;
+        if (solutionmem)
+            lines[11] = mline;
+        else
+            tolog("Calibration: Runs could not be put in jobs, so their memory is cmd's: memory limits are left as they are.", LOG_WARN);
+
+        // Write it under another name first, so the config is never half written.
+        ofstream out(config + ".tmp");
+        for (size_t i = 0; i < lines.size(); ++i)
+            out << lines[i] << "\n";
+        out.close();
+        if (out.fail())
+            halt(crash, "themisv2: Calibration: Cannot write the config!");
+        movefile(config + ".tmp", config);
+        return 0;
+    }
+};
+
+typedef __themisv2_judgecontext__ judgecontext;
+
+#endif // __THEMISV2_JUDGE__
@@ -0,0 +1,291 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains themisv2's logger. It is included by themisv2.h, do not include it directly.
+**/
+#ifndef __THEMISV2_LOGGER__
+#define __THEMISV2_LOGGER__
+
+/* Log levels. Lines below the current level are dropped before they are queued. */
+#define LOG_DEBUG 0
+#define LOG_INFO  1
+#define LOG_WARN  2
+#define LOG_ERROR 3
+
+/* Log sinks. They can be combined, eg. SINK_FILE | SINK_CONSOLE. */
+#define SINK_FILE    1
+#define SINK_CONSOLE 2
+
+/* Number of slots in the ring buffer (must be a power of two). */
+#define LOG_RING_SIZE 4096
+
+/* Logfile:
+   --------
+   You can use the logfile in order to develop an interface, etc.
+   It will be as clear as possible.
+
+   UNDERSTANDING:
+   --------------
+   - Logs appear one per line.
+   - Each line starts with date and time then exitcode and message.
+*/
+string logfile;
+
+/* A logger that never touches the disk or the console on the caller's thread.
+
+   UNDERSTANDING:
+   --------------
+   - push() puts the line into a lock-free ring buffer (many writers, one reader).
+   - A background thread drains the ring every few milliseconds and writes the whole
+     batch to the sinks at once, so there is one write per batch instead of one flush per line.
+   - When the ring is full, writers wait for the drainer rather than dropping lines.
+   - Checkers and randomers (compiled with THEMISV2) have no thread, they write directly.
+
+   CONFIGURATION (environment variables):
+   --------------------------------------
+   THEMISV2_LOGLEVEL  -  "debug", "info" (default), "warn" or "error".
+   THEMISV2_LOGSINKS  -  "file", "console" or "file,console" (default).
+   THEMISV2_LOGSTAMP  -  "1" to prefix every line with [MM/DD/YYYY hh:mm:ss].
+*/
+class __themisv2_logger__ {
+private:
+    /* One queued line. *seq* tells who owns the slot (Vyukov's bounded queue). */
+    struct slot {
+        volatile long seq;
+        int           level;
+        time_t        when;
+        string        msg;
+    };
+
+    /* Ring buffer and its positions. *head* is shared by writers, *tail* is the drainer's. */
+    slot*         ring;
+    volatile long head, tail;
+
+    /* Current level, sinks and whether lines are stamped. */
+    int  level, sinks;
+    bool stamp;
+
+    /* The logfile (opened lazily by the drainer). */
+    FILE* file;
+
+    /* Cached stamp, only rebuilt when the second changes. Only the drainer touches it. */
+    time_t last;
+    char   cached[32];
+
+#ifndef THEMISV2
+    /* Drainer thread, its wake-up event and its state. */
+    HANDLE        thread, wake;
+    volatile long running;
+
+    /* Drainer thread entry. */
+    static DWORD WINAPI drainer (LPVOID self) {
+        __themisv2_logger__* p = (__themisv2_logger__*)self;
+        while (p->running) {
+            WaitForSingleObject(p->wake, 20);
+            p->drain();
+        }
+        p->drain();
+        return 0;
+    }
+
+    /* Start the drainer on the first push. */
+    void start() {
+        if (InterlockedCompareExchange(&running, 1, 0) != 0)
+            return;
+        wake   = CreateEvent(NULL, FALSE, FALSE, NULL);
+        thread = CreateThread(NULL, 0, drainer, this, 0, NULL);
+        if (!thread)
+            running = 0;
+    }
+#endif
+
+    /* Get the stamp of *when*. */
+    const char* stampof (time_t when) {
+        if (when != last) {
+            last = when;
+            strftime(cached, sizeof cached, "[%m/%d/%Y %H:%M:%S] ", localtime(&when));
+        }
+        return cached;
+    }
+
+    /* Write a batch to all sinks. */
+    void write (const string& batch) {
+        if (batch.empty())
+            return;
+        if ((sinks & SINK_FILE) && !file && logfile.size())
+            file = fopen(logfile.c_str(), "a");
+        if ((sinks & SINK_FILE) && file) {
+            fwrite(batch.data(), 1, batch.size(), file);
+            fflush(file);
+        }
+        if (sinks & SINK_CONSOLE) {
+            fwrite(batch.data(), 1, batch.size(), stderr);
+            fflush(stderr);
+        }
+    }
+
+    /* Append one line to the batch. */
+    void format (string& batch, time_t when, const string& msg) {
+        if (stamp)
+            batch += stampof(when);
+        batch += msg;
+        batch += '\n';
+    }
+
+    /* Move every ready line from the ring to the sinks. Only one thread may drain at a time. */
+    void drain() {
+        string batch;
+        for (;;) {
+            slot& s = ring[tail & (LOG_RING_SIZE - 1)];
+            if (s.seq - (tail + 1) < 0)
+                break;
+            format(batch, s.when, s.msg);
+            s.msg.clear();
+#ifndef THEMISV2
+            InterlockedExchange(&s.seq, tail + LOG_RING_SIZE);
+#else
+            s.seq = tail + LOG_RING_SIZE;
+#endif
+            ++tail;
+        }
+        write(batch);
+    }
+public:
+    /* Initialization. */
+    __themisv2_logger__() {
+        ring = new slot[LOG_RING_SIZE];
+        for (long i = 0; i < LOG_RING_SIZE; ++i)
+            ring[i].seq = i;
+        head  = tail = 0;
+        level = LOG_INFO;
+        sinks = SINK_FILE | SINK_CONSOLE;
+        stamp = 0;
+        file  = NULL;
+        last  = 0;
+#ifndef THEMISV2
+        thread  = wake = NULL;
+        running = 0;
+#endif
+
+        const char* env;
+        if ((env = getenv("THEMISV2_LOGLEVEL")) != NULL) {
+            string t(env);
+            level = t == "debug" ? LOG_DEBUG : t == "warn" ? LOG_WARN : t == "error" ? LOG_ERROR : LOG_INFO;
+        }
+        if ((env = getenv("THEMISV2_LOGSINKS")) != NULL) {
+            string t(env);
+            sinks = SINK_FILE * (t.find("file") != string::npos) | SINK_CONSOLE * (t.find("console") != string::npos);
+        }
+        if ((env = getenv("THEMISV2_LOGSTAMP")) != NULL)
+            stamp = string(env) == "1";
+    }
+
+    /* Drain everything that is left before the program ends. */
+    ~__themisv2_logger__() {
+        stop();
+        delete[] ring;
+    }
+
+    /* Set the minimum level, the sinks and the stamp. */
+    void setlevel (int _level) { level = _level; }
+    void setsinks (int _sinks) { sinks = _sinks; }
+    void setstamp (bool _stamp) { stamp = _stamp; }
+    int  getlevel() const { return level; }
+
+    /* Queue one line. It never blocks unless the ring is full. */
+    void push (int _level, const string& msg) {
+        if (_level < level)
+            return;
+#ifdef THEMISV2
+        string batch;
+        format(batch, time(0), msg);
+        write(batch);
+#else
+        if (!running)
+            start();
+        if (!running) {
+            // No thread, no queue.
+            string batch;
+            format(batch, time(0), msg);
+            write(batch);
+            return;
+        }
+
+        // Claim a slot.
+        long pos = head;
+        slot* s;
+        for (;;) {
+            s = &ring[pos & (LOG_RING_SIZE - 1)];
+            long dif = s->seq - pos;
+            if (dif == 0) {
+                if (InterlockedCompareExchange(&head, pos + 1, pos) == pos)
+                    break;
+            } else if (dif < 0) {
+                // The ring is full, let the drainer catch up.
+                SetEvent(wake);
+                Sleep(0);
+            }
+            pos = head;
+        }
+
+        // Fill and publish it.
+        s->level = _level;
+        s->when  = time(0);
+        s->msg   = msg;
+        InterlockedExchange(&s->seq, pos + 1);
+
+        // Only wake the drainer early for errors or when the ring is half full.
+        if (_level >= LOG_ERROR || pos - tail >= LOG_RING_SIZE / 2)
+            SetEvent(wake);
+#endif
+    }
+
+    /* Wait until everything queued so far has reached the sinks. */
+    void flush() {
+#ifndef THEMISV2
+        if (!running)
+            return;
+        long target = head;
+        while (tail - target < 0) {
+            SetEvent(wake);
+            Sleep(1);
+        }
+#endif
+    }
+
+    /* Stop the drainer (after draining) and close the logfile. */
+    void stop() {
+#ifndef THEMISV2
+        if (InterlockedCompareExchange(&running, 0, 1) == 1) {
+            SetEvent(wake);
+            WaitForSingleObject(thread, INFINITE);
+            CloseHandle(thread);
+            CloseHandle(wake);
+        }
+#endif
+        drain();
+        if (file)
+            fclose(file);
+        file = NULL;
+    }
+};
+
+__themisv2_logger__ __logger__;
+
+#endif // __THEMISV2_LOGGER__
@@ -0,0 +1,201 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains TCP connections (Winsock) used between a coordinator and its workers.
+**/
+#ifndef __THEMISV2_NETWORK__
+#define __THEMISV2_NETWORK__
+
+#include "themisv2.h"
+
+/* Start Winsock. Call it from the main thread before using any connection. */
+void netstart() {
+    static bool started = 0;
+    if (started)
+        return;
+    WSADATA d;
+    if (WSAStartup(MAKEWORD(2, 2), &d))
+        halt(crash, "Network: Cannot start Winsock!");
+    started = 1;
+}
+
+/* A TCP connection carrying lines and blobs.
+   A blob is sent as the line "<tag> <size>", then *size* bytes.
+   All functions return 0 once the connection is broken (then it stays broken).
+*/
+class __themisv2_connection__ {
+private:
+    SOCKET s;
+    string buf; /* Received, not read yet. */
+
+    __themisv2_connection__ (const __themisv2_connection__&);
+    __themisv2_connection__& operator= (const __themisv2_connection__&);
+
+    /* Receive more into the buffer. */
+    bool more() {
+        char t[1 << 16];
+        int n = s == INVALID_SOCKET ? 0 : recv(s, t, sizeof t, 0);
+        if (n <= 0) {
+            close();
+            return 0;
+        }
+        buf.append(t, n);
+        return 1;
+    }
+public:
+    __themisv2_connection__ (SOCKET _s = INVALID_SOCKET): s(_s) {}
+
+    ~__themisv2_connection__() {
+        close();
+    }
+
+    /* Connect to *host*:*port*. Returns 0 if nobody listens there. */
+    bool open (const string& host, const string& port) {
+        close();
+        addrinfo hints, *res;
+        memset(&hints, 0, sizeof hints);
+        hints.ai_family   = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res))
+            return 0;
+        s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (s != INVALID_SOCKET && connect(s, res->ai_addr, (int)res->ai_addrlen))
+            close();
+        freeaddrinfo(res);
+        return s != INVALID_SOCKET;
+    }
+
+    void close() {
+        if (s != INVALID_SOCKET)
+            closesocket(s);
+        s = INVALID_SOCKET;
+    }
+
+    inline bool is_open() const { return s != INVALID_SOCKET; }
+
+    /* Give up (and break the connection) when sending or receiving takes more than *ms* milliseconds (0: never). */
+    void timeout (ui ms) {
+        DWORD t = ms;
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&t, sizeof t);
+        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&t, sizeof t);
+    }
+
+    /* Send *n* bytes. */
+    bool sendall (const char* p, size_t n) {
+        while (n && s != INVALID_SOCKET) {
+            int w = send(s, p, (int)min(n, (size_t)1 << 20), 0);
+            if (w <= 0)
+                close();
+            else
+                p += w, n -= w;
+        }
+        return s != INVALID_SOCKET;
+    }
+
+    /* Send a line (without '\n'). */
+    bool sendline (const string& line) {
+        string t = line + "\n";
+        return sendall(t.data(), t.size());
+    }
+
+    /* Send a blob with its tag. */
+    bool sendblob (const string& tag, const char* p, size_t n) {
+        return sendline(tag + " " + to_string((ull)n)) && sendall(p, n);
+    }
+
+    /* Read a line (without '\n'). */
+    bool readline (string& line) {
+        size_t e;
+        while ((e = buf.find('\n')) == string::npos)
+            if (!more())
+                return 0;
+        line = buf.substr(0, e);
+        buf.erase(0, e + 1);
+        return 1;
+    }
+
+    /* Read *n* bytes. */
+    bool readbytes (string& r, size_t n) {
+        while (buf.size() < n)
+            if (!more())
+                return 0;
+        r = buf.substr(0, n);
+        buf.erase(0, n);
+        return 1;
+    }
+
+    /* Read a blob, which must have *tag*. */
+    bool readblob (const string& tag, string& r) {
+        string line;
+        ull n;
+        if (!readline(line) || line.compare(0, tag.size() + 1, tag + " ") || sscanf(line.c_str() + tag.size(), "%llu", &n) != 1)
+            return 0;
+        return readbytes(r, (size_t)n);
+    }
+};
+
+typedef __themisv2_connection__ connection;
+
+/* A TCP listener that gives connections. */
+class __themisv2_listener__ {
+private:
+    SOCKET s;
+
+    __themisv2_listener__ (const __themisv2_listener__&);
+    __themisv2_listener__& operator= (const __themisv2_listener__&);
+public:
+    __themisv2_listener__(): s(INVALID_SOCKET) {}
+
+    ~__themisv2_listener__() {
+        if (s != INVALID_SOCKET)
+            closesocket(s);
+    }
+
+    /* Listen on *port* of the interface with the IPv4 address *addr* ("0.0.0.0" for every interface). Returns 0 if it cannot. */
+    bool open (ui port, const string& addr = "127.0.0.1") {
+        unsigned long ip = inet_addr(addr.c_str());
+        if (ip == INADDR_NONE)
+            return 0;
+        s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET)
+            return 0;
+        sockaddr_in a;
+        memset(&a, 0, sizeof a);
+        a.sin_family      = AF_INET;
+        a.sin_addr.s_addr = ip;
+        a.sin_port        = htons((u_short)port);
+        return !bind(s, (sockaddr*)&a, sizeof a) && !listen(s, SOMAXCONN);
+    }
+
+    /* Wait up to *ms* milliseconds for a connection. Returns NULL if none comes. */
+    connection* accept (ui ms) {
+        fd_set r;
+        FD_ZERO(&r);
+        FD_SET(s, &r);
+        timeval t = {(long)(ms / 1000), (long)(ms % 1000 * 1000)};
+        if (select(0, &r, NULL, NULL, &t) <= 0)
+            return NULL;
+        SOCKET c = ::accept(s, NULL, NULL);
+        return c == INVALID_SOCKET ? NULL : new connection(c);
+    }
+};
+
+typedef __themisv2_listener__ listener;
+
+#endif // __THEMISV2_NETWORK__
@@ -0,0 +1,188 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the prefetcher which warms the page cache with tests before they are timed.
+**/
+#ifndef __THEMISV2_PREFETCH__
+#define __THEMISV2_PREFETCH__
+
+#include "testpack.h"
+
+/* Sets of tests up to this size (in bytes) are also locked in memory until judging ends. */
+#define PREFETCH_LOCK_LIMIT (64ULL << 20)
+
+/* While judging, tests are read at most this many tests ahead of the running one. */
+#define PREFETCH_WINDOW 4
+
+/* A piece of a test to read ahead: a part of *file* (all of it if *len* is 0) belonging to test *test*. */
+struct prefetchpiece {
+    string file;
+    ull    off, len;
+    ui     test;
+};
+
+/* A prefetcher reading files in the background so that they are in the page cache when a solution reads them.
+
+   UNDERSTANDING:
+   --------------
+   - Windows has no readahead() nor posix_fadvise(), so I read every piece sequentially with
+     FILE_FLAG_SEQUENTIAL_SCAN, which makes the cache manager read ahead aggressively.
+   - Small sets are also mapped and locked (VirtualLock) so they cannot be trimmed from memory while judging.
+   - It runs on its own thread while the solution and the checker compile, reading the tests in order.
+     Call finish() before the first test: from then on it keeps at most PREFETCH_WINDOW tests ahead of the running one
+     (call advance() when a test starts), so every run starts with a hot input without the prefetcher reading the whole
+     set while runs are timed. Only sets read completely by finish() are locked.
+   It is on unless the environment variable THEMISV2_PREFETCH is "0".
+*/
+class __themisv2_prefetcher__ {
+private:
+    vector<prefetchpiece> pieces;
+    vector<string>        files;    /* Every file of the pieces, once. */
+    HANDLE                thread, wake;
+    volatile LONG         stopping, complete, judging, current;
+    volatile ull          bytes;
+    ull                   total;
+    bool                  finished;
+    vector<filemap*>      maps;
+    vector<mapview>       locked;
+
+    /* Read a piece. */
+    void read (const prefetchpiece& c, vector<char>& buf) {
+        HANDLE h = CreateFile(c.file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (h == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER at;
+        at.QuadPart = c.off;
+        ull left = c.len ? c.len : ~0ULL;
+        DWORD r;
+        if (SetFilePointerEx(h, at, NULL, FILE_BEGIN))
+            while (left && !stopping && ReadFile(h, buf.data(), (DWORD)min((ull)buf.size(), left), &r, NULL) && r)
+                bytes += r, left -= r;
+        CloseHandle(h);
+    }
+
+    /* Prefetcher thread entry. */
+    static DWORD WINAPI worker (LPVOID self) {
+        __themisv2_prefetcher__* p = (__themisv2_prefetcher__*)self;
+        tracescope ts("prefetch", "io");
+        vector<char> buf(1 << 20);
+        size_t i = 0;
+        for (; i < p->pieces.size() && !p->stopping; ++i) {
+            const prefetchpiece& c = p->pieces[i];
+            // While judging, wait until the piece is in the window, and skip what has already been run.
+            while (!p->stopping && p->judging && c.test >= (ui)p->current + PREFETCH_WINDOW)
+                WaitForSingleObject(p->wake, INFINITE);
+            if (p->stopping)
+                break;
+            if (!p->judging || c.test >= (ui)p->current)
+                p->read(c, buf);
+            if (i + 1 == p->pieces.size() && !p->judging)
+                p->complete = 1;
+        }
+        return 0;
+    }
+
+    /* Map and lock every file (small sets only). */
+    void lock() {
+        SIZE_T lo, hi;
+        GetProcessWorkingSetSize(GetCurrentProcess(), &lo, &hi);
+        if (!SetProcessWorkingSetSize(GetCurrentProcess(), lo + (SIZE_T)total, hi + (SIZE_T)total))
+            return;
+        for (size_t i = 0; i < files.size(); ++i) {
+            filemap* m = new filemap;
+            maps.pb(m);
+            if (!m->open(files[i]) || !m->size())
+                continue;
+            locked.pb(m->view(0, (size_t)m->size()));
+            VirtualLock((LPVOID)locked.back().data(), locked.back().size());
+        }
+    }
+
+    /* Stop reading and wait for the thread. */
+    void stop() {
+        if (!thread)
+            return;
+        stopping = 1;
+        SetEvent(wake);
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+        CloseHandle(wake);
+        thread = wake = NULL;
+    }
+public:
+    __themisv2_prefetcher__(): thread(NULL), wake(NULL), stopping(0), complete(0), judging(0), current(0), bytes(0), total(0), finished(0) {}
+
+    /* Judging is over (or never started, eg. after a compilation error): nothing is locked here. */
+    ~__themisv2_prefetcher__() {
+        stop();
+        locked.clear();
+        for (size_t i = 0; i < maps.size(); ++i)
+            delete maps[i];
+    }
+
+    /* Is prefetching wanted? */
+    static bool wanted() {
+        const char* env = getenv("THEMISV2_PREFETCH");
+        return !env || string(env) != "0";
+    }
+
+    /* Start prefetching pieces of tests, in the order of their tests. */
+    void start (const vector<prefetchpiece>& _pieces) {
+        pieces = _pieces;
+        files.clear();
+        total = 0;
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            if (!files.empty() && files.back() == pieces[i].file)
+                continue;
+            files.pb(pieces[i].file);
+            ll size;
+            ull mtime;
+            if (fileinfo(files.back(), size, mtime))
+                total += size;
+        }
+        wake   = CreateEvent(NULL, FALSE, FALSE, NULL);
+        thread = CreateThread(NULL, 0, worker, this, 0, NULL);
+    }
+
+    /* The first test starts: from now on only read the window ahead of the running test.
+       Lock small sets read completely and return the number of bytes prefetched so far.
+    */
+    ull finish() {
+        if (finished || !thread)
+            return bytes;
+        finished = 1;
+        judging  = 1;
+        SetEvent(wake);
+        if (complete && total <= PREFETCH_LOCK_LIMIT)
+            lock();
+        return bytes;
+    }
+
+    /* Test *test* starts: move the window. */
+    void advance (ui test) {
+        if (!thread)
+            return;
+        current = test;
+        SetEvent(wake);
+    }
+};
+
+typedef __themisv2_prefetcher__ prefetcher;
+
+#endif // __THEMISV2_PREFETCH__
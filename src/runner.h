@@ -22,19 +22,251 @@
 #ifndef __THEMISV2_RUNNER__
 #define __THEMISV2_RUNNER__
 
-#include "themisv2.h"
+#include "tracer.h"
 
 #define TIME_LIMIT_DEF 1000
 #define MEM_LIMIT_DEF  262144
 
+const ui     __TIMELINE_SIZE__ = 512; /* Most samples in a run's timeline (see sampleevery()). */
+const double __IDLE_RATIO__ = 0.01; /* A run using less CPU time than this part of its wall time is idle (see idlelimit()). */
+
+/* Something that can be fed to a process' stdin piece by piece. */
+class __themisv2_source__ {
+public:
+    virtual ~__themisv2_source__() {}
+
+    /* Get the next piece in *p*. Returns its length, 0 at the end. */
+    virtual size_t next (const char*& p) = 0;
+};
+
+typedef __themisv2_source__ source;
+
+/* A piece of memory (eg. a mapped test) as a source. Nothing is copied. */
+class __themisv2_memsource__ : public __themisv2_source__ {
+private:
+    const char* data;
+    size_t      left;
+public:
+    __themisv2_memsource__ (const char* _data, size_t _len): data(_data), left(_len) {}
+
+    size_t next (const char*& p) {
+        size_t n = min(left, (size_t)1 << 20);
+        p     = data;
+        data += n;
+        left -= n;
+        return n;
+    }
+};
+
+typedef __themisv2_memsource__ memsource;
+
+/* --- Run isolation ---
+   Measured runs (run_and_wait_in_time_limit()) can be kept away from each other and from themisv2 itself:
+   - THEMISV2_CORES lists logical processors (eg. "2,4,6") set aside for solutions. Each run is pinned to one of them
+     and holds its whole physical core (so its SMT siblings stay idle for measured runs), through a named mutex per core,
+     so runs of every themisv2 on the machine (or every judge context in one) never share a core.
+     themisv2 itself (and its checkers, compilers, ...) is pinned to the other processors.
+     A parallel run (see parallel()) holds as many cores as it is given.
+   - THEMISV2_PRIORITY gives measured runs a fixed priority class: "normal", "above", "high" or "realtime".
+   Every measured run is put in a job object, so the affinity and the priority also hold for the solution started by cmd,
+   its memory is the peak of its biggest process (the solution, not cmd, see memused()), and stopping the run kills all
+   of it. Context switches of the run are counted while it runs (see contextswitches()).
+*/
+
+/* One core set aside for measured runs. */
+struct isolatedcore {
+    ui        cpu;    /* The logical processor runs are pinned to. */
+    DWORD_PTR owned;  /* Every logical processor of its physical core. */
+    HANDLE    lock;   /* Held while a run uses the core. */
+};
+
+/* Isolation settings, read once. */
+struct runisolation {
+    vector<isolatedcore> cores;
+    DWORD                priority; /* Priority class (0 to leave it). */
+};
+
+/* Logical processors sharing a physical core with *cpu* (*cpu* alone if it is unknown). */
+DWORD_PTR siblings (ui cpu) {
+    DWORD n = 0;
+    GetLogicalProcessorInformation(NULL, &n);
+    vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(n / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+    n = info.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+    if (GetLogicalProcessorInformation(info.data(), &n))
+        for (size_t i = 0; i < n / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); ++i)
+            if (info[i].Relationship == RelationProcessorCore && (info[i].ProcessorMask >> cpu & 1))
+                return info[i].ProcessorMask;
+    return (DWORD_PTR)1 << cpu;
+}
+
+/* Read the isolation settings and pin themisv2 away from the isolated cores. */
+runisolation makeisolation() {
+    runisolation r;
+    const char* env = getenv("THEMISV2_PRIORITY");
+    string p = env ? env : "";
+    r.priority = p == "normal" ? NORMAL_PRIORITY_CLASS : p == "above" ? ABOVE_NORMAL_PRIORITY_CLASS :
+                 p == "high" ? HIGH_PRIORITY_CLASS : p == "realtime" ? REALTIME_PRIORITY_CLASS : 0;
+
+    env = getenv("THEMISV2_CORES");
+    if (!env || !*env)
+        return r;
+    DWORD_PTR proc, sys, all = 0;
+    GetProcessAffinityMask(GetCurrentProcess(), &proc, &sys);
+    vector<string> c = split(env, ',');
+    for (size_t i = 0; i < c.size(); ++i) {
+        ui cpu = atoi(c[i].c_str());
+        if (cpu >= sizeof(DWORD_PTR) * 8 || !(sys >> cpu & 1))
+            halt(crash, rfmt("Process Handler: There is no processor %d!", cpu));
+        isolatedcore k;
+        k.cpu   = cpu;
+        k.owned = siblings(cpu);
+        // One lock per physical core (named after its first logical processor), shared by everyone on the machine.
+        ui first = 0;
+        while (!(k.owned >> first & 1))
+            ++first;
+        k.lock = CreateMutex(NULL, FALSE, rfmt("Local\\themisv2_core_%d", first).c_str());
+        if (!k.lock)
+            halt(crash, "Process Handler: Cannot make the core lock!");
+        r.cores.pb(k);
+        all |= k.owned;
+    }
+    if (sys & ~all)
+        SetProcessAffinityMask(GetCurrentProcess(), sys & ~all);
+    return r;
+}
+
+/* The isolation settings, read by the first call (from any thread: the static is initialized once). */
+const runisolation& isolation() {
+    static const runisolation r = makeisolation();
+    return r;
+}
+
+/* Take *n* free isolated cores (all of them if there are fewer), waiting for them if they are used.
+   Returns their indexes (none if there is no isolated core).
+   Runs taking several cores take them one by one behind a machine-wide gate, so two of them never wait for each other.
+*/
+vector<int> acquirecores (ui n) {
+    const runisolation& r = isolation();
+    vector<int> got;
+    if (r.cores.empty())
+        return got;
+    n = min(n, (ui)r.cores.size());
+    static HANDLE gate = CreateMutex(NULL, FALSE, "Local\\themisv2_cores");
+    if (n > 1)
+        WaitForSingleObject(gate, INFINITE);
+    vector<bool> taken(r.cores.size(), 0);
+    while (got.size() < n) {
+        vector<HANDLE> locks;
+        vector<int>    ids;
+        for (size_t i = 0; i < r.cores.size(); ++i)
+            if (!taken[i])
+                locks.pb(r.cores[i].lock), ids.pb(i);
+        // A lock left by a killed themisv2 is abandoned, and taken all the same.
+        DWORD w = WaitForMultipleObjects(locks.size(), locks.data(), FALSE, INFINITE);
+        if (w >= WAIT_OBJECT_0 && w < WAIT_OBJECT_0 + locks.size())
+            w -= WAIT_OBJECT_0;
+        else if (w >= WAIT_ABANDONED_0 && w < WAIT_ABANDONED_0 + locks.size())
+            w -= WAIT_ABANDONED_0;
+        else
+            halt(crash, "Process Handler: Cannot take an isolated core!");
+        taken[ids[w]] = 1;
+        got.pb(ids[w]);
+    }
+    if (n > 1)
+        ReleaseMutex(gate);
+    return got;
+}
+
+/* Give isolated cores back (from the thread that took them). */
+void releasecores (const vector<int>& k) {
+    for (size_t i = 0; i < k.size(); ++i)
+        ReleaseMutex(isolation().cores[k[i]].lock);
+}
+
+/* Threads as NtQuerySystemInformation(SystemProcessInformation) gives them. */
+struct ntthread {
+    LARGE_INTEGER KernelTime, UserTime, CreateTime;
+    ULONG         WaitTime;
+    PVOID         StartAddress;
+    HANDLE        UniqueProcess, UniqueThread;
+    LONG          Priority, BasePriority;
+    ULONG         ContextSwitches, ThreadState, WaitReason;
+};
+
+/* Processes as NtQuerySystemInformation(SystemProcessInformation) gives them, followed by their threads. */
+struct ntprocess {
+    ULONG         NextEntryOffset, NumberOfThreads;
+    LARGE_INTEGER Reserved[3], CreateTime, UserTime, KernelTime;
+    USHORT        NameLength, NameMaximumLength;
+    PWSTR         NameBuffer;
+    LONG          BasePriority;
+    HANDLE        UniqueProcessId, InheritedFromUniqueProcessId;
+    ULONG         HandleCount, SessionId;
+    ULONG_PTR     PageDirectoryBase;
+    SIZE_T        PeakVirtualSize, VirtualSize;
+    ULONG         PageFaultCount;
+    SIZE_T        PeakWorkingSetSize, WorkingSetSize, QuotaPeakPagedPoolUsage, QuotaPagedPoolUsage,
+                  QuotaPeakNonPagedPoolUsage, QuotaNonPagedPoolUsage, PagefileUsage, PeakPagefileUsage, PrivatePageCount;
+    LARGE_INTEGER ReadOperationCount, WriteOperationCount, OtherOperationCount,
+                  ReadTransferCount, WriteTransferCount, OtherTransferCount;
+};
+
+typedef LONG (WINAPI *ntquerysysteminformation)(int, PVOID, ULONG, PULONG);
+
+/* Context switches of every thread of the processes *pids*, so far. Processes that are gone are not counted. */
+map<DWORD, ull> contextswitches (const vector<DWORD>& pids) {
+    static ntquerysysteminformation q = (ntquerysysteminformation)GetProcAddress(GetModuleHandle("ntdll.dll"), "NtQuerySystemInformation");
+    map<DWORD, ull> r;
+    if (!q || pids.empty())
+        return r;
+    vector<char> buf(1 << 18);
+    ULONG n;
+    LONG  st;
+    while ((st = q(5, buf.data(), buf.size(), &n)) == (LONG)0xC0000004)
+        buf.resize(max((size_t)n, buf.size()) * 2);
+    if (st < 0)
+        return r;
+    for (size_t off = 0;;) {
+        const ntprocess* p = (const ntprocess*)(buf.data() + off);
+        DWORD pid = (DWORD)(ULONG_PTR)p->UniqueProcessId;
+        if (find(ALL(pids), pid) != pids.end()) {
+            const ntthread* t = (const ntthread*)(p + 1);
+            ull c = 0;
+            for (ULONG i = 0; i < p->NumberOfThreads; ++i)
+                c += t[i].ContextSwitches;
+            r[pid] = c;
+        }
+        if (!p->NextEntryOffset)
+            break;
+        off += p->NextEntryOffset;
+    }
+    return r;
+}
+
+/* Held while a Process inheriting handles is created, so no other Process (started by another thread) inherits them. */
+CRITICAL_SECTION& spawnlock() {
+    static struct lock {
+        CRITICAL_SECTION cs;
+        lock() { InitializeCriticalSection(&cs); }
+    } l;
+    return l.cs;
+}
+
+/* One sample of a run's timeline. */
+struct runsample {
+    ui at,   /* Since the run started (ms). */
+       mem,  /* Memory used then, by every process of the run (KB). */
+       cpu;  /* CPU time used so far (ms). */
+};
+
 /* A class for processing command quickly and efficiently.
    It provides functions and voids for accessing process and doing many stuffs.
    Remember to call stop() whenever you do not need it anymore.
 */
 class __themisv2_processhandler__ {
 private:
-    /* Command of the Process. */
-    string cmd;
+    /* Command of the Process (without redirections) and where its stdin, stdout and stderr go. */
+    string cmd, cmdin, cmdout, cmderr;
 
     /* Startup Info for CreateProcess. */
     STARTUPINFO si;
@@ -48,6 +280,172 @@ private:
     /* Memory limit for Process (in KiloBytes). */
     ui mem;
 
+    /* Source fed to the Process' stdin through a pipe (NULL if stdin is a file), the pipe and its feeder. */
+    source* src;
+    HANDLE  feed_wr, feed_thread;
+
+    /* Does the feeder throw like its owner (library mode)? What did it throw? */
+    bool       feed_throws, feed_failed;
+    judgeerror feed_error;
+
+    /* Pipes to talk with the Process line by line (see talk()), and what has been read but not taken yet. */
+    bool   talking;
+    HANDLE talk_wr, talk_rd;
+    string talk_buf;
+
+    /* Is it a measured run (see run isolation)? Its job, its isolated cores and its context switches per process. */
+    bool            measured;
+    HANDLE          job;
+    vector<int>     held;
+    map<DWORD, ull> switches;
+
+    /* Cores a measured run is given, and the most processes it can have at once besides cmd (0 for no cap). */
+    ui width, procs;
+
+    /* Idle limit of a measured run (in milliseconds, 0 for none). */
+    clock_t idle;
+
+    /* Timeline of a measured run (see sampleevery()) and the time between its samples (0 for no timeline). */
+    vector<runsample> timeline;
+    clock_t           every;
+
+    /* Put the (suspended) Process in a job with the isolation limits, then let it go.
+       Its cores are taken before it is created (see start()), so waiting for them is not part of its time.
+    */
+    void isolate() {
+        const runisolation& r = isolation();
+        job = CreateJobObject(NULL, NULL);
+        DWORD_PTR mask = 0;
+        for (size_t i = 0; i < held.size(); ++i)
+            mask |= (DWORD_PTR)1 << r.cores[held[i]].cpu;
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION l;
+        memset(&l, 0, sizeof l);
+        l.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        if (mask) {
+            l.BasicLimitInformation.LimitFlags   |= JOB_OBJECT_LIMIT_AFFINITY;
+            l.BasicLimitInformation.Affinity      = mask;
+        }
+        if (procs) {
+            l.BasicLimitInformation.LimitFlags        |= JOB_OBJECT_LIMIT_ACTIVE_PROCESS;
+            l.BasicLimitInformation.ActiveProcessLimit = procs + 1;
+        }
+        if (r.priority) {
+            l.BasicLimitInformation.LimitFlags   |= JOB_OBJECT_LIMIT_PRIORITY_CLASS;
+            l.BasicLimitInformation.PriorityClass = r.priority;
+        }
+        if (!job || !SetInformationJobObject(job, JobObjectExtendedLimitInformation, &l, sizeof l)
+                 || !AssignProcessToJobObject(job, pi.hProcess)) {
+            // themisv2 may be in a job that allows no other (before Windows 8): set what can be set on the Process.
+            if (job)
+                CloseHandle(job);
+            job = NULL;
+            if (mask)
+                SetProcessAffinityMask(pi.hProcess, mask);
+            if (r.priority)
+                SetPriorityClass(pi.hProcess, r.priority);
+            tolog("Process Handler: Cannot put the process in a job.", LOG_DEBUG);
+        }
+        ResumeThread(pi.hThread);
+    }
+
+    /* Processes of the run (the Process alone if it has no job). */
+    vector<DWORD> processes() {
+        vector<DWORD> r;
+        if (!job) {
+            r.pb(pi.dwProcessId);
+            return r;
+        }
+        char buf[sizeof(JOBOBJECT_BASIC_PROCESS_ID_LIST) + 64 * sizeof(ULONG_PTR)];
+        JOBOBJECT_BASIC_PROCESS_ID_LIST* l = (JOBOBJECT_BASIC_PROCESS_ID_LIST*)buf;
+        if (QueryInformationJobObject(job, JobObjectBasicProcessIdList, l, sizeof buf, NULL) || GetLastError() == ERROR_MORE_DATA)
+            for (DWORD i = 0; i < l->NumberOfProcessIdsInList; ++i)
+                r.pb((DWORD)l->ProcessIdList[i]);
+        return r;
+    }
+
+    /* CPU time (in 1e-7 seconds) used by every process of the job so far. */
+    ull cputime() {
+        JOBOBJECT_BASIC_ACCOUNTING_INFORMATION a;
+        if (!job || !QueryInformationJobObject(job, JobObjectBasicAccountingInformation, &a, sizeof a, NULL))
+            return 0;
+        return a.TotalUserTime.QuadPart + a.TotalKernelTime.QuadPart;
+    }
+
+    /* Memory (KB) used by every process of the run now. */
+    ui memnow() {
+        vector<DWORD> p = processes();
+        ull r = 0;
+        for (size_t i = 0; i < p.size(); ++i) {
+            HANDLE h = p[i] == pi.dwProcessId ? pi.hProcess : OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, p[i]);
+            PROCESS_MEMORY_COUNTERS pmc = {sizeof(PROCESS_MEMORY_COUNTERS)};
+            if (h && GetProcessMemoryInfo(h, &pmc, sizeof(pmc)))
+                r += pmc.PagefileUsage;
+            if (h && h != pi.hProcess)
+                CloseHandle(h);
+        }
+        return (ui)(r / 1024);
+    }
+
+    /* Add a sample to the timeline. A full timeline keeps every other sample, and samples half as often from then on. */
+    void sample (ui at) {
+        if (timeline.size() == __TIMELINE_SIZE__) {
+            for (size_t i = 0; i < timeline.size() / 2; ++i)
+                timeline[i] = timeline[i * 2];
+            timeline.resize(timeline.size() / 2);
+            every *= 2;
+        }
+        runsample s = {at, memnow(), (ui)(cputime() / 10000)};
+        timeline.pb(s);
+    }
+
+    /* Count context switches of the run so far. */
+    void sampleswitches() {
+        map<DWORD, ull> now = ::contextswitches(processes());
+        for (map<DWORD, ull>::iterator it = now.begin(); it != now.end(); ++it)
+            switches[it->first] = it->second;
+    }
+
+    /* Feeder thread: write the source to the pipe until it ends or the Process stops reading. */
+    static DWORD WINAPI feeder (LPVOID self) {
+        __themisv2_processhandler__* p = (__themisv2_processhandler__*)self;
+        __halt_throws__ = p->feed_throws;
+        const char* d;
+        size_t n;
+        try {
+            while ((n = p->src->next(d)) > 0)
+                while (n) {
+                    DWORD w;
+                    if (!WriteFile(p->feed_wr, d, (DWORD)min(n, (size_t)1 << 16), &w, NULL))
+                        goto done;
+                    d += w;
+                    n -= w;
+                }
+        } catch (const judgeerror& e) {
+            // Given back to the owner by stop().
+            p->feed_failed = 1;
+            p->feed_error  = e;
+        }
+    done:
+        // Closing the pipe tells the Process that its input ends here.
+        CloseHandle(p->feed_wr);
+        p->feed_wr = NULL;
+        return 0;
+    }
+
+    /* Create the Process with the handles *h* (the child's ends of its pipes, made without inheritance), which are
+       inheritable only while it is created, then closed. Returns 0 if it cannot be created.
+    */
+    bool spawn (const string& full, const vector<HANDLE>& h, DWORD flags) {
+        EnterCriticalSection(&spawnlock());
+        for (size_t i = 0; i < h.size(); ++i)
+            SetHandleInformation(h[i], HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+        bool ok = CreateProcess(NULL, const_cast<char*> (full.c_str()), NULL, NULL, TRUE, flags, NULL, NULL, &si, &pi);
+        for (size_t i = 0; i < h.size(); ++i)
+            CloseHandle(h[i]);
+        LeaveCriticalSection(&spawnlock());
+        return ok;
+    }
+
     /* ConvertFileTime function for QuadPart 1e-7 seconds (must learn). */
     static ULONGLONG ConvertFileTime (const FILETIME* t) {
         ULARGE_INTEGER tmp;
@@ -57,10 +455,22 @@ private:
 public:
     /* Initialization. */
     __themisv2_processhandler__() {
-        cmd  = "";
+        cmd  = cmdin = cmdout = cmderr = "";
         time = TIME_LIMIT_DEF;
         mem  = MEM_LIMIT_DEF;
         si   = {sizeof(STARTUPINFO)};
+        pi   = {};
+        src  = NULL;
+        feed_wr = feed_thread = NULL;
+        feed_throws = feed_failed = 0;
+        talking = 0;
+        talk_wr = talk_rd = NULL;
+        measured = 0;
+        job  = NULL;
+        idle = 0;
+        width = 1;
+        procs = 0;
+        every = 0;
     }
 
     /* Constructor. */
@@ -85,31 +495,106 @@ public:
         time = _time;
         mem  = _mem;
         si   = {sizeof(STARTUPINFO)};
+        pi   = {};
+        src  = NULL;
+        feed_wr = feed_thread = NULL;
+        feed_throws = feed_failed = 0;
+        talking = 0;
+        talk_wr = talk_rd = NULL;
+        measured = 0;
+        job  = NULL;
+        idle = 0;
+        width = 1;
+        procs = 0;
+        every = 0;
 
 		// Arguments
 		cmd += " " + _argline;
 
         // You need Input?
         if (!_input.empty())
-            cmd += " < \"" + _input + "\"";
+            cmdin = " < \"" + _input + "\"";
 		else
-			cmd += " <nul ";
+			cmdin = " <nul ";
 
         // You need Output?
         if (!_output.empty())
-            cmd += " > \"" + _output + "\"";
+            cmdout = " > \"" + _output + "\"";
 		else
-			cmd += " >nul ";
+			cmdout = " >nul ";
 
         // You need Stderr?
         if (!_stderr.empty()) {
 			if (_stderr == _output)
-				cmd += " 2>&1";
+				cmderr = " 2>&1";
 			else
-				cmd += " 2> \"" + _stderr + "\"";
+				cmderr = " 2> \"" + _stderr + "\"";
 		}
+    }
+
+    /* A Process left running (eg. by a halt() thrown in library mode) is stopped here. */
+    ~__themisv2_processhandler__() {
+        feed_failed = 0;
+        if (pi.hProcess || feed_thread || talk_wr || job || !held.empty())
+            stop();
+    }
+
+    /* Feed the Process' stdin from *_src* instead of the input file. Call it before start().
+       The source must live until stop().
+    */
+    void feed (source* _src) {
+        src = _src;
+        cmdin = "";
+    }
+
+    /* Talk with the Process instead: its stdin and stdout become pipes, used by writeline() and readline().
+       Call it before start().
+    */
+    void talk() {
+        talking = 1;
+        cmdin = cmdout = "";
+    }
 
-		cmd += "\"";
+    /* Send one line to the Process. Returns 0 if it does not listen anymore. */
+    bool writeline (const string& s) {
+        string t = s + "\n";
+        const char* d = t.data();
+        size_t n = t.size();
+        while (n) {
+            DWORD w;
+            if (!WriteFile(talk_wr, d, (DWORD)n, &w, NULL))
+                return 0;
+            d += w;
+            n -= w;
+        }
+        return 1;
+    }
+
+    /* Get one line from the Process (without its end). Returns 0 if it has nothing more to say,
+       or if the line has not come in *ms* milliseconds.
+    */
+    bool readline (string& s, DWORD ms = INFINITE) {
+        DWORD start = GetTickCount();
+        size_t k;
+        while ((k = talk_buf.find('\n')) == string::npos) {
+            char d[4096];
+            DWORD r, avail = 0;
+            // Anonymous pipes cannot be read with a timeout: wait for something to read first.
+            if (ms != INFINITE)
+                while (PeekNamedPipe(talk_rd, NULL, 0, NULL, &avail, NULL) && !avail) {
+                    if (GetTickCount() - start >= ms)
+                        return 0;
+                    Sleep(1);
+                }
+            if (!ReadFile(talk_rd, d, sizeof d, &r, NULL) || !r)
+                return 0;
+            talk_buf.append(d, r);
+        }
+        s = talk_buf.substr(0, k);
+        talk_buf.erase(0, k + 1);
+        if (!s.empty() && s[s.size() - 1] == '\r')
+            s.erase(s.size() - 1);
+        return 1;
     }
 
     /* ---  Powerful voids start here  --- */
@@ -118,20 +603,107 @@ public:
        All options will be set to default.
     */
     void start() {
-        if (!CreateProcess(NULL, const_cast<char*> (cmd.c_str()), NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+        tracescope ts("spawn", "proc");
+        string full = cmd + cmdout + cmderr + cmdin + "\"";
+        if (talking) {
+            // Make two pipes: the Process reads the first one and writes the second one.
+            HANDLE rd, wr;
+            if (!CreatePipe(&rd, &talk_wr, NULL, 1 << 16) || !CreatePipe(&talk_rd, &wr, NULL, 1 << 16))
+                halt(crash, "Process Handler: Cannot create pipe!");
+            si.dwFlags   |= STARTF_USESTDHANDLES;
+            si.hStdInput  = rd;
+            si.hStdOutput = wr;
+            si.hStdError  = GetStdHandle(STD_ERROR_HANDLE);
+            HANDLE ends[] = {rd, wr};
+            if (!spawn(full, vector<HANDLE>(ends, ends + 2), 0))
+                halt(crash, "Process Handler: Cannot create process!");
+            return;
+        }
+        DWORD flags = measured ? CREATE_SUSPENDED : 0;
+        if (measured)
+            held = acquirecores(width);
+        if (!src) {
+            if (!CreateProcess(NULL, const_cast<char*> (full.c_str()), NULL, NULL, FALSE, flags, NULL, NULL, &si, &pi)) {
+                releasecores(held);
+                held.clear();
+                halt(crash, "Process Handler: Cannot create process!");
+            }
+            if (measured)
+                isolate();
+            return;
+        }
+
+        // Make a pipe, give its reading end to the Process and feed the other end.
+        HANDLE rd;
+        if (!CreatePipe(&rd, &feed_wr, NULL, 1 << 16)) {
+            releasecores(held);
+            held.clear();
+            halt(crash, "Process Handler: Cannot create pipe!");
+        }
+        si.dwFlags   |= STARTF_USESTDHANDLES;
+        si.hStdInput  = rd;
+        si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        si.hStdError  = GetStdHandle(STD_ERROR_HANDLE);
+        if (!spawn(full, vector<HANDLE>(1, rd), flags)) {
+            releasecores(held);
+            held.clear();
             halt(crash, "Process Handler: Cannot create process!");
+        }
+        if (measured)
+            isolate();
+        feed_throws = __halt_throws__;
+        feed_thread = CreateThread(NULL, 0, feeder, this, 0, NULL);
+        if (!feed_thread)
+            halt(crash, "Process Handler: Cannot create feeder!");
     }
 
     /* I'm using CloseHandle for closing a Process. */
     void stop() {
-		TerminateProcess(pi.hProcess, 0);
-		TerminateThread(pi.hThread, 0);
-        CloseHandle(pi.hThread);
-		CloseHandle(pi.hProcess);
+        if (job) {
+            // Everything the run started goes with it.
+            TerminateJobObject(job, 0);
+            CloseHandle(job);
+            job = NULL;
+        }
+        releasecores(held);
+        held.clear();
+        if (pi.hProcess) {
+            TerminateProcess(pi.hProcess, 0);
+            TerminateThread(pi.hThread, 0);
+            CloseHandle(pi.hThread);
+            CloseHandle(pi.hProcess);
+            pi.hProcess = pi.hThread = NULL;
+        }
+        if (feed_thread) {
+            // The feeder ends once nobody holds the pipe's reading end anymore.
+            if (WaitForSingleObject(feed_thread, 1000) != WAIT_OBJECT_0)
+                TerminateThread(feed_thread, 0);
+            CloseHandle(feed_thread);
+            feed_thread = NULL;
+        }
+        if (feed_wr) {
+            CloseHandle(feed_wr);
+            feed_wr = NULL;
+        }
+        if (talk_wr) {
+            CloseHandle(talk_wr);
+            CloseHandle(talk_rd);
+            talk_wr = talk_rd = NULL;
+        }
+        if (feed_failed) {
+            feed_failed = 0;
+            throw feed_error;
+        }
     }
 
-    /* I'm using PMC for determining PeakPagefileUsage (Maximum used memory). */
+    /* I'm using PMC for determining PeakPagefileUsage (Maximum used memory).
+       A run in a job uses the job's PeakProcessMemoryUsed instead: the same peak, of its biggest process,
+       since the Process itself is only cmd.
+    */
     ui memused() {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION l;
+        if (job && QueryInformationJobObject(job, JobObjectExtendedLimitInformation, &l, sizeof l, NULL))
+            return l.PeakProcessMemoryUsed / 1024;
         PROCESS_MEMORY_COUNTERS pmc = {sizeof(PROCESS_MEMORY_COUNTERS)};
         if (!GetProcessMemoryInfo(pi.hProcess, &pmc, sizeof(pmc)))
             halt(crash, "Process Handler: Cannot get memory info!");
@@ -163,21 +735,81 @@ public:
         return (ui)(1e-4 * (ConvertFileTime(&Exit) - ConvertFileTime(&Creation)));
     }
 
+    /* Give a measured run *cores* isolated cores instead of one (when there are isolated cores, see run isolation),
+       and let it have at most *processes* processes at once (0 for no cap). Windows cannot cap threads, so a run can
+       have any number of threads, but they only share its cores. Call it before run_and_wait_in_time_limit().
+    */
+    void parallel (ui cores, ui processes) {
+        width = max(cores, (ui)1);
+        procs = processes;
+    }
+
+    /* Sample the memory and CPU time of a measured run every *ms* milliseconds (see timelineof()).
+       Samples are taken between the checks of run_and_wait_in_time_limit(), so they cost no extra waiting;
+       a long run keeps at most __TIMELINE_SIZE__ of them. Call it before run_and_wait_in_time_limit().
+    */
+    void sampleevery (clock_t ms) {
+        every = ms;
+    }
+
+    /* Is the run in a job (so its memory and CPU time are the solution's, not cmd's)? Call it before stop(). */
+    bool injob() const {
+        return job != NULL;
+    }
+
+    /* Timeline of a measured run (empty if it was not sampled). */
+    const vector<runsample>& timelineof() const {
+        return timeline;
+    }
+
+    /* Stop a measured run that stays idle for *ms* milliseconds, ie. uses less than __IDLE_RATIO__ of that time on CPU
+       (eg. waiting for input that never comes, or sleeping), instead of letting it hold on until the time limit.
+       The CPU time is the one of the whole job, so it needs the run to be in a job. Call it before run_and_wait_in_time_limit().
+    */
+    void idlelimit (clock_t ms) {
+        idle = ms;
+    }
+
     /* This function runs and waits for the program and terminate it if it reaches time limit.
        - It should return inf   if the program has a TLE-verdict.
        - It should return 2*inf if the program has a MLE-verdict.
+       - It should return 3*inf if the program has been idle for its idle limit.
        Otherwise, it returns the exit code.
        ** mem_used is used for saving maximum used memory.
 	   ** time_used is used for saving consumed time.
     */
     ui run_and_wait_in_time_limit (ui& mem_used, ui& time_used) {
+        measured = 1;
         start();
-        clock_t now = clock();
+        tracescope ts("wait", "proc");
+        clock_t now = clock(), sampled = now, checked = now, mark = now, stamp = now;
+        bool count = !isolation().cores.empty();
+        ull  busy  = 0;
         while (opening() && clock() - now <= time) {
             mem_used = memused();
             if (mem_used > mem)
                 return 2 * inf;
+            // Context switches are only counted on isolated runs, where themisv2 does not share their core.
+            if (count && clock() - sampled >= 10) {
+                sampleswitches();
+                sampled = clock();
+            }
+            // Idle since *mark* if it has not used enough CPU time since then.
+            if (idle && job && clock() - checked >= 10) {
+                checked = clock();
+                ull cpu = cputime();
+                if (cpu - busy >= (ull)(idle * 1e4 * __IDLE_RATIO__))
+                    busy = cpu, mark = checked;
+                else if (checked - mark > idle)
+                    return 3u * inf;
+            }
+            if (every && clock() - stamp >= every) {
+                stamp = clock();
+                sample(stamp - now);
+            }
         }
+        if (count)
+            sampleswitches();
         if (opening())
             return inf;
         time_used = timeinfo();
@@ -187,6 +819,40 @@ public:
     /* Or you just want to run it and do not care what it happens (no MLE and TLE checks). */
     ui run_and_wait() {
         start();
+        return wait();
+    }
+
+    /* Context switches of a measured run (counted while it runs, on isolated runs only). */
+    ull contextswitches() const {
+        ull r = 0;
+        for (map<DWORD, ull>::const_iterator it = switches.begin(); it != switches.end(); ++it)
+            r += it->second;
+        return r;
+    }
+
+    /* The logical processors a measured run was pinned to (none if it was not). It never migrates from there. */
+    vector<ui> pinnedcpus() const {
+        vector<ui> r;
+        for (size_t i = 0; i < held.size(); ++i)
+            r.pb(isolation().cores[held[i]].cpu);
+        return r;
+    }
+
+    /* CPU time (in milliseconds) of a measured run: every thread of every process of it, so it is more than the time used
+       when the run works in parallel. Call it before stop(). Without a job, only cmd's own CPU time is known.
+    */
+    ui cpuused() {
+        if (job)
+            return (ui)(cputime() / 10000);
+        FILETIME Creation, Exit, Kernal, User;
+        if (!pi.hProcess || !GetProcessTimes(pi.hProcess, &Creation, &Exit, &Kernal, &User))
+            return 0;
+        return (ui)((ConvertFileTime(&Kernal) + ConvertFileTime(&User)) / 10000);
+    }
+
+    /* Wait for a started process (no MLE and TLE checks) and return its exit code. */
+    ui wait() {
+        tracescope ts("wait", "proc");
         if (WaitForSingleObject(pi.hProcess, INFINITE) != WAIT_OBJECT_0)
 			halt(crash, "Process Handler: Cannot wait for process!");
         return exitcode();
@@ -0,0 +1,175 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the scheduler of the submission queue.
+**/
+#ifndef __THEMISV2_SCHEDULER__
+#define __THEMISV2_SCHEDULER__
+
+#include "themisv2.h"
+#include <map>
+#include <set>
+
+const double __SCHED_PRETEST__ = 0.25;  /* Cost factor of pretests. */
+const double __SCHED_FIRST__   = 0.5;   /* Cost factor of first submissions. */
+const double __SCHED_AGING__   = 100.0; /* Priority (ms) won by every second of waiting. */
+
+/* A submission waiting to be judged. */
+struct queuedjob {
+    string id,         /* Name of the submission. */
+           contestant,
+           config;     /* Config to judge it with. */
+    bool   pretest,    /* Is it judged on pretests? */
+           first;      /* Is it the contestant's first submission? (Set by the scheduler.) */
+    double cost;       /* Estimated judging time in ms (see estimatecost()). */
+    ui     cores;      /* Cores its runs are given (see the cores option). */
+    DWORD  queued;     /* When it was queued (GetTickCount()). */
+
+    queuedjob(): pretest(0), first(0), cost(0), cores(1), queued(0) {}
+};
+
+/* Estimated judging time of a config in ms: the sum of its time limits (11st line), plus a bit for every test. */
+double estimatecost (const string& config) {
+    ifstream ins(config);
+    string s;
+    for (int i = 0; i < 11 && getline(ins, s); ++i);
+    stringstream r(s);
+    ui n, x;
+    double c = 0;
+    if (r >> n)
+        for (ui i = 0; i < n && r >> x; ++i)
+            c += x + 20;
+    return c;
+}
+
+/* The scheduler of the submission queue. It is not FIFO:
+   - Short jobs first: the submission with the smallest estimated cost goes first (a cost is counted once per core
+     the job's runs are given)...
+   - ...but with fair share: every contestant has a usage, the estimated cost of what was judged for them.
+     A submission's priority is its cost plus its contestant's usage, so one contestant sending many submissions
+     only gets their turns after the others. A new contestant starts with the smallest usage of those waiting.
+   - Boosts: pretests and first submissions count a fraction of their cost.
+   - Aging: every second of waiting takes __SCHED_AGING__ ms off, so nothing waits forever.
+   The smallest priority is judged first. All functions can be called from any thread.
+*/
+class __themisv2_scheduler__ {
+private:
+    vector<queuedjob>   jobs;
+    map<string, double> usage;
+    set<string>         seen;   /* Contestants who have submitted. */
+    CRITICAL_SECTION    cs;
+    ull                 popped; /* Number of jobs taken. */
+    double              waited; /* Their total waiting time in ms. */
+
+    __themisv2_scheduler__ (const __themisv2_scheduler__&);
+    __themisv2_scheduler__& operator= (const __themisv2_scheduler__&);
+
+    /* Priority of a job at *now* (smaller first). */
+    double priority (const queuedjob& j, DWORD now) {
+        double c = j.cost * j.cores * (j.pretest ? __SCHED_PRETEST__ : 1) * (j.first ? __SCHED_FIRST__ : 1);
+        return usage[j.contestant] + c - (now - j.queued) / 1000.0 * __SCHED_AGING__;
+    }
+public:
+    __themisv2_scheduler__(): popped(0), waited(0) {
+        InitializeCriticalSection(&cs);
+    }
+
+    ~__themisv2_scheduler__() {
+        DeleteCriticalSection(&cs);
+    }
+
+    /* Queue a job. Its cost is estimated from its config if it is not given. */
+    void push (queuedjob j) {
+        if (!j.cost)
+            j.cost = estimatecost(j.config);
+        EnterCriticalSection(&cs);
+        j.queued = GetTickCount();
+        j.first  = seen.insert(j.contestant).se;
+        if (!usage.count(j.contestant)) {
+            double least = 0;
+            bool   any   = 0;
+            for (size_t i = 0; i < jobs.size(); ++i)
+                if (!any || usage[jobs[i].contestant] < least)
+                    least = usage[jobs[i].contestant], any = 1;
+            usage[j.contestant] = least;
+        }
+        jobs.pb(j);
+        LeaveCriticalSection(&cs);
+    }
+
+    /* Take the next job. Returns 0 if the queue is empty. */
+    bool pop (queuedjob& j) {
+        EnterCriticalSection(&cs);
+        DWORD now = GetTickCount();
+        size_t best = jobs.size();
+        double p = 0;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            double q = priority(jobs[i], now);
+            if (best == jobs.size() || q < p)
+                best = i, p = q;
+        }
+        bool ok = best < jobs.size();
+        if (ok) {
+            j = jobs[best];
+            jobs.erase(jobs.begin() + best);
+            usage[j.contestant] += j.cost * j.cores;
+            ++popped;
+            waited += now - j.queued;
+        }
+        LeaveCriticalSection(&cs);
+        return ok;
+    }
+
+    /* A job taken by pop() is judged in *ms* ms: its contestant's usage is corrected with the real cost. */
+    void done (const queuedjob& j, double ms) {
+        EnterCriticalSection(&cs);
+        usage[j.contestant] += (ms - j.cost) * j.cores;
+        LeaveCriticalSection(&cs);
+    }
+
+    /* Number of waiting jobs. */
+    size_t depth() {
+        EnterCriticalSection(&cs);
+        size_t r = jobs.size();
+        LeaveCriticalSection(&cs);
+        return r;
+    }
+
+    /* How long the oldest waiting job has waited, in ms. */
+    DWORD oldestwait() {
+        EnterCriticalSection(&cs);
+        DWORD now = GetTickCount(), r = 0;
+        for (size_t i = 0; i < jobs.size(); ++i)
+            r = max(r, now - jobs[i].queued);
+        LeaveCriticalSection(&cs);
+        return r;
+    }
+
+    /* Average waiting time of the jobs taken so far, in ms. */
+    double averagewait() {
+        EnterCriticalSection(&cs);
+        double r = popped ? waited / popped : 0;
+        LeaveCriticalSection(&cs);
+        return r;
+    }
+};
+
+typedef __themisv2_scheduler__ scheduler;
+
+#endif // __THEMISV2_SCHEDULER__
@@ -0,0 +1,248 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the test index: which tests exist, in which order, and their sizes and times.
+**/
+#ifndef __THEMISV2_TESTINDEX__
+#define __THEMISV2_TESTINDEX__
+
+#include "codec.h"
+#include <map>
+
+/* One test of the index. *name* is the test's number as written, eg. "7", "07" or "00007".
+   *inz* and *ansz* tell whether the input and the answer are compressed (.thz).
+*/
+struct testentry {
+    string name;
+    ull    num;
+    ll     insize, anssize;
+    ull    inmtime, ansmtime;
+    bool   inz, ansz;
+};
+
+/* A FILETIME as one number. */
+inline ull filetime (const FILETIME& t) {
+    return ((ull)t.dwHighDateTime << 32) | t.dwLowDateTime;
+}
+
+/* Is *s* a test's number? */
+inline bool istestnumber (const string& s) {
+    if (s.empty() || s.size() > 18)
+        return 0;
+    for (size_t i = 0; i < s.size(); ++i)
+        if (!isdigit(s[i]))
+            return 0;
+    return 1;
+}
+
+/* Size and last write time of a file without opening it. Returns 0 if it does not exist. */
+bool fileinfo (const string& fn, ll& size, ull& mtime) {
+    WIN32_FILE_ATTRIBUTE_DATA d;
+    if (!GetFileAttributesEx(fn.c_str(), GetFileExInfoStandard, &d) || (d.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return 0;
+    size  = ((ll)d.nFileSizeHigh << 32) | d.nFileSizeLow;
+    mtime = filetime(d.ftLastWriteTime);
+    return 1;
+}
+
+/* Sort tests by their numbers, then keep 0, 1, 2, ... until the first missing number. */
+void sorttests (vector<testentry>& r) {
+    sort(ALL(r), [](const testentry& a, const testentry& b) {
+        return a.num != b.num ? a.num < b.num : a.name < b.name;
+    });
+    size_t n = 0;
+    for (size_t i = 0; i < r.size(); ++i) {
+        if (r[i].num < n)
+            tolog(rfmt("Test index: Test \"%s\" has the same number as test \"%s\", ignored.", r[i].name.c_str(), r[n - 1].name.c_str()), LOG_WARN);
+        else if (r[i].num == n)
+            r[n++] = r[i];
+        else {
+            tolog(rfmt("Test index: Test %d is missing, tests from \"%s\" are ignored.", (int)n, r[i].name.c_str()), LOG_WARN);
+            break;
+        }
+    }
+    r.resize(n);
+}
+
+/* Scan the tests' folder once and build the index.
+   - In "stdio" mode, tests are files <number>.in and <number>.ans.
+   - In "fixedio" mode, tests are folders <number> holding <fixed_input> and <fixed_output>.
+   Any of these files may be compressed instead, with ".thz" appended to its name (eg. 00.in.thz).
+   If both forms exist, the uncompressed one is used.
+*/
+vector<testentry> scantests (const string& dir, bool _stdio, const string& fin = "", const string& fout = "") {
+    tracescope ts("scan tests");
+    vector<testentry> r;
+    WIN32_FIND_DATA d;
+    HANDLE h = FindFirstFile((dir + "\\*").c_str(), &d);
+    if (h == INVALID_HANDLE_VALUE)
+        return r;
+
+    if (_stdio) {
+        // Pair <number>.in with <number>.ans.
+        map<string, size_t> at;
+        do {
+            if (d.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            string s = d.cFileName;
+            bool   z = isthz(s);
+            if (z)
+                s = s.substr(0, s.size() - 4);
+            size_t k = s.rfind('.');
+            if (k == string::npos || !istestnumber(s.substr(0, k)))
+                continue;
+            string name = s.substr(0, k), ext = s.substr(k + 1);
+            if (ext != "in" && ext != "ans")
+                continue;
+            if (!at.count(name)) {
+                at[name] = r.size();
+                r.pb(testentry{name, strtoull(name.c_str(), NULL, 10), -1, -1, 0, 0, 0, 0});
+            }
+            testentry& e = r[at[name]];
+            ll  size  = ((ll)d.nFileSizeHigh << 32) | d.nFileSizeLow;
+            ull mtime = filetime(d.ftLastWriteTime);
+            if (ext == "in") {
+                if (e.insize < 0 || e.inz)
+                    e.insize = size, e.inmtime = mtime, e.inz = z;
+            } else {
+                if (e.anssize < 0 || e.ansz)
+                    e.anssize = size, e.ansmtime = mtime, e.ansz = z;
+            }
+        } while (FindNextFile(h, &d));
+    } else {
+        // Folders <number>, each holding both fixed files.
+        do {
+            string s = d.cFileName;
+            if (!(d.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !istestnumber(s))
+                continue;
+            testentry e = {s, strtoull(s.c_str(), NULL, 10), -1, -1, 0, 0, 0, 0};
+            string t = dir + "\\" + s + "\\";
+            if (!fileinfo(t + fin, e.insize, e.inmtime))
+                e.inz = fileinfo(t + fin + ".thz", e.insize, e.inmtime);
+            if (!fileinfo(t + fout, e.anssize, e.ansmtime))
+                e.ansz = fileinfo(t + fout + ".thz", e.anssize, e.ansmtime);
+            r.pb(e);
+        } while (FindNextFile(h, &d));
+    }
+    FindClose(h);
+
+    // Drop incomplete tests.
+    size_t n = 0;
+    for (size_t i = 0; i < r.size(); ++i)
+        if (r[i].insize >= 0 && r[i].anssize >= 0)
+            r[n++] = r[i];
+    r.resize(n);
+
+    sorttests(r);
+    return r;
+}
+
+/* Destination of a test's input (ans = 0) or answer (ans = 1) in the tests' folder. */
+string testpath (const string& dir, const testentry& e, bool _stdio, const string& fin, const string& fout, bool ans) {
+    string t = dir + "\\" + e.name;
+    if (_stdio)
+        t += ans ? ".ans" : ".in";
+    else
+        t += "\\" + (ans ? fout : fin);
+    return t + string(".thz") * (ans ? e.ansz : e.inz);
+}
+
+/* --- Manifest tools begin here --- */
+
+/* The manifest remembers the index of a tests' folder together with the folder's last write time.
+   Adding, removing or renaming a test changes that time. Editing a test in place (or anything in the folders of
+   "fixedio" tests) does not, so the index is also compared with one listing of the folder (see scantests()), which
+   gives every size and last write time at once: no file is looked at on its own. The manifest is only written again
+   when something changed, under another name first, so an interrupted write never leaves half of it.
+
+   FORM:
+   -----
+   [1st line]   themisv2-manifest 2 <folder's last write time>
+   [next lines] <name> <input's size> <input's time> <answer's size> <answer's time> <input compressed?> <answer compressed?>
+*/
+const char* __MANIFEST_MAGIC__ = "themisv2-manifest";
+
+/* Last write time of a folder (0 if it cannot be read). */
+ull foldertime (const string& dir) {
+    WIN32_FILE_ATTRIBUTE_DATA d;
+    if (!GetFileAttributesEx(dir.c_str(), GetFileExInfoStandard, &d))
+        return 0;
+    return filetime(d.ftLastWriteTime);
+}
+
+/* Are two indexes the same (same tests, sizes, times and forms)? */
+bool sametests (const vector<testentry>& a, const vector<testentry>& b) {
+    if (a.size() != b.size())
+        return 0;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].name != b[i].name || a[i].insize != b[i].insize || a[i].inmtime != b[i].inmtime || a[i].anssize != b[i].anssize
+            || a[i].ansmtime != b[i].ansmtime || a[i].inz != b[i].inz || a[i].ansz != b[i].ansz)
+            return 0;
+    return 1;
+}
+
+/* Load a manifest. Returns 0 if it is missing, broken or older than the folder. */
+bool loadmanifest (const string& fn, const string& dir, vector<testentry>& r) {
+    ifstream f(fn);
+    string magic;
+    int version;
+    ull mtime;
+    if (!(f >> magic >> version >> mtime) || magic != __MANIFEST_MAGIC__ || version != 2)
+        return 0;
+    if (!mtime || mtime != foldertime(dir))
+        return 0;
+    r.clear();
+    testentry e;
+    while (f >> e.name >> e.insize >> e.inmtime >> e.anssize >> e.ansmtime >> e.inz >> e.ansz) {
+        e.num = strtoull(e.name.c_str(), NULL, 10);
+        r.pb(e);
+    }
+    return 1;
+}
+
+/* Save a manifest. */
+void savemanifest (const string& fn, const string& dir, const vector<testentry>& r) {
+    string tmp = fn + ".tmp";
+    ofstream f(tmp);
+    if (!f.is_open())
+        return;
+    f << __MANIFEST_MAGIC__ << " 2 " << foldertime(dir) << "\n";
+    for (size_t i = 0; i < r.size(); ++i)
+        f << r[i].name << " " << r[i].insize << " " << r[i].inmtime << " " << r[i].anssize << " " << r[i].ansmtime
+          << " " << r[i].inz << " " << r[i].ansz << "\n";
+    f.close();
+    if (!f || !MoveFileEx(tmp.c_str(), fn.c_str(), MOVEFILE_REPLACE_EXISTING))
+        DeleteFile(tmp.c_str());
+}
+
+/* Get the index of a tests' folder, checking its manifest in *cache* against one listing of the folder. */
+vector<testentry> indextests (const string& dir, bool _stdio, const string& fin, const string& fout, const string& cache) {
+    string key = dir + "|" + (_stdio ? "stdio" : "fixedio|" + fin + "|" + fout);
+    string fn  = rfmt("%smanifest_%s.txt", cache.c_str(), tohex(fnv(key.data(), key.size())).c_str());
+    vector<testentry> r = scantests(dir, _stdio, fin, fout), m;
+    if (loadmanifest(fn, dir, m) && sametests(m, r)) {
+        tolog(rfmt("Test index: %d tests (manifest is up to date).", (int)r.size()), LOG_DEBUG);
+        return r;
+    }
+    savemanifest(fn, dir, r);
+    tolog(rfmt("Test index: %d tests (manifest rewritten).", (int)r.size()), LOG_DEBUG);
+    return r;
+}
+
+#endif // __THEMISV2_TESTINDEX__
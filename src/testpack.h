@@ -0,0 +1,175 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the test pack: all tests of a problem in one indexed file.
+**/
+#ifndef __THEMISV2_TESTPACK__
+#define __THEMISV2_TESTPACK__
+
+#include "utility.h"
+#include "testindex.h"
+
+/* Test pack's form (all numbers are little-endian):
+   [header] "THV2PACK" (8 bytes), version (4 bytes), number of tests *n* (4 bytes).
+   [index]  *n* entries, sorted by test number. Each of them has the test's name (24 bytes, zero-padded),
+            then the offset, the length and the FNV-1a hash of the input, then the same three for the answer (8 bytes each).
+   [data]   Inputs and answers.
+   In "fixedio" mode, the input is <fixed_input> and the answer is <fixed_output> of the test's folder.
+*/
+struct packheader {
+    char magic[8];
+    ui   version, count;
+};
+
+struct packentry {
+    char name[24];
+    ull  inoff, inlen, inhash,
+         ansoff, anslen, anshash;
+};
+
+const char __PACK_MAGIC__[8] = {'T', 'H', 'V', '2', 'P', 'A', 'C', 'K'};
+
+/* A mapped test pack. Inputs and answers are served straight from the mapping. */
+class __themisv2_testpack__ {
+private:
+    filemap           f;
+    vector<packentry> idx;
+public:
+    /* Open a pack. Returns 0 if it cannot be opened, halts if it is broken. */
+    bool open (const string& fn) {
+        if (!f.open(fn))
+            return 0;
+        if (f.size() < sizeof(packheader))
+            halt(crash, "Test pack: Broken header!");
+        packheader h;
+        {
+            mapview v = f.view(0, sizeof h);
+            memcpy(&h, v.data(), sizeof h);
+        }
+        if (memcmp(h.magic, __PACK_MAGIC__, 8) || h.version != 1)
+            halt(crash, "Test pack: Not a version 1 test pack!");
+        if (sizeof h + (ull)h.count * sizeof(packentry) > f.size())
+            halt(crash, "Test pack: Broken index!");
+
+        idx.resize(h.count);
+        if (h.count) {
+            mapview v = f.view(sizeof h, h.count * sizeof(packentry));
+            memcpy(&idx[0], v.data(), v.size());
+        }
+        for (size_t i = 0; i < idx.size(); ++i) {
+            idx[i].name[23] = 0;
+            if (idx[i].inoff + idx[i].inlen > f.size() || idx[i].ansoff + idx[i].anslen > f.size())
+                halt(crash, rfmt("Test pack: Test \"%s\" is out of the pack!", idx[i].name));
+        }
+        return 1;
+    }
+
+    inline size_t           count() const { return idx.size(); }
+    inline const packentry& entry (size_t i) const { return idx[i]; }
+
+    /* Map the input and the answer of a test. */
+    mapview input (size_t i) const {
+        return f.view(idx[i].inoff, (size_t)idx[i].inlen);
+    }
+
+    mapview answer (size_t i) const {
+        return f.view(idx[i].ansoff, (size_t)idx[i].anslen);
+    }
+
+    /* The pack as a test index. */
+    vector<testentry> index() const {
+        vector<testentry> r;
+        for (size_t i = 0; i < idx.size(); ++i)
+            r.pb(testentry{idx[i].name, strtoull(idx[i].name, NULL, 10), (ll)idx[i].inlen, (ll)idx[i].anslen, 0, 0, 0, 0});
+        sorttests(r);
+        if (r.size() != idx.size())
+            halt(crash, "Test pack: Tests must be numbered 0, 1, 2, ...!");
+        return r;
+    }
+};
+
+typedef __themisv2_testpack__ testpack;
+
+/* Does the tests' destination look like a pack? */
+inline bool ispack (const string& tests) {
+    return tests.size() > 5 && tests.substr(tests.size() - 5) == ".pack";
+}
+
+/* Build a pack from a tests' folder (see scantests() for the folder's layout). Returns the number of tests.
+   Compressed tests are decompressed into the pack block by block.
+*/
+size_t buildpack (const string& dir, bool _stdio, const string& fin, const string& fout, const string& fn) {
+    vector<testentry> tests = scantests(dir, _stdio, fin, fout);
+    vector<packentry> idx(tests.size());
+    FILE* f = fopen(fn.c_str(), "wb");
+    if (!f)
+        halt(crash, "Test pack: Cannot create the pack!");
+
+    // Index first (filled with zeroes), the hashes are only known after the data is written.
+    packheader h;
+    memcpy(h.magic, __PACK_MAGIC__, 8);
+    h.version = 1;
+    h.count   = tests.size();
+    memset(idx.data(), 0, idx.size() * sizeof(packentry));
+    fwrite(&h, sizeof h, 1, f);
+    fwrite(idx.data(), sizeof(packentry), idx.size(), f);
+
+    ull off = sizeof h + idx.size() * sizeof(packentry);
+    for (size_t i = 0; i < tests.size(); ++i) {
+        if (tests[i].name.size() > 23)
+            halt(crash, rfmt("Test pack: Test name \"%s\" is too long!", tests[i].name.c_str()));
+        strcpy(idx[i].name, tests[i].name.c_str());
+        for (int k = 0; k < 2; ++k) {
+            string fn = testpath(dir, tests[i], _stdio, fin, fout, k);
+            ull* e = k ? &idx[i].ansoff : &idx[i].inoff;
+            e[0] = off;
+            if (k ? tests[i].ansz : tests[i].inz) {
+                thzsource s(fn);
+                const char* p;
+                size_t n;
+                e[1] = 0;
+                e[2] = fnv("", 0);
+                while ((n = s.next(p)) > 0) {
+                    if (fwrite(p, 1, n, f) != n)
+                        halt(crash, "Test pack: Cannot write the pack!");
+                    e[1] += n;
+                    e[2]  = fnv(p, n, e[2]);
+                }
+            } else {
+                filemap m;
+                if (!m.open(fn))
+                    halt(crash, rfmt("Test pack: Cannot open \"%s\"!", fn.c_str()));
+                mapview v = m.view(0, (size_t)m.size());
+                if (fwrite(v.data(), 1, v.size(), f) != v.size())
+                    halt(crash, "Test pack: Cannot write the pack!");
+                e[1] = v.size();
+                e[2] = fnv(v.data(), v.size());
+            }
+            off += e[1];
+        }
+    }
+
+    // Now the real index.
+    fseek(f, sizeof h, SEEK_SET);
+    fwrite(idx.data(), sizeof(packentry), idx.size(), f);
+    fclose(f);
+    return tests.size();
+}
+
+#endif // __THEMISV2_TESTPACK__
@@ -35,6 +35,8 @@
 
 #ifndef THEMISV2
 #include <conio.h>
+#include <winsock2.h> /* Before windows.h, which would bring the old winsock.h. */
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <tchar.h>
 #include <psapi.h>
@@ -47,6 +49,11 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <map>
 
 /* Macro-defined exitcodes. */
 #define CE    2
@@ -66,6 +73,7 @@ using namespace std;
 
 typedef long long ll;
 typedef unsigned int ui;
+typedef unsigned long long ull;
 
 typedef pair<int, int> pi;
 typedef vector<int>    vi;
@@ -73,18 +81,7 @@ typedef vector<pi>     vp;
 
 const int inf = 0x3f3f3f3f;
 
-/* Logfile:
-   --------
-   You can use the logfile in order to develop an interface, etc.
-   It will be as clear as possible.
-
-   UNDERSTANDING:
-   --------------
-   - Logs appear one per line.
-   - Each line starts with date and time then exitcode and message.
-*/
-string logfile;
-fstream err;
+#include "logger.h"
 
 /* Translate exitcode to message. */
 string trans (const int& exitcode) {
@@ -121,6 +118,21 @@ inline string to_string (const T& t) {
     return r;
 }
 
+/* FNV-1a hash of *n* bytes. Pass the previous hash as *h* to hash data piece by piece. */
+inline ull fnv (const void* data, size_t n, ull h = 14695981039346656037ULL) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+/* Hexadecimal form of a hash. */
+inline string tohex (const ull& h) {
+    char s[17];
+    snprintf(s, sizeof s, "%016llx", h);
+    return s;
+}
+
 /* Minimize. */
 template<typename T>
 inline void mini (T& a, const T& b) {
@@ -169,46 +181,77 @@ string rfmt (const char* fmt...) {
     return r.str();
 }
 
-/* Write logs. */
-void tolog (const string& r) {
-    if (!err.is_open())
-        if (logfile.size())
-            open(err, logfile);
-    if (logfile.size())
-        err << r << endl;
-    cerr << r << endl;
+/* Library mode (see judge.h), per thread:
+   - halt() throws a judgeerror instead of exiting the program.
+   - Logs go to *__logcapture__* instead of the logger.
+*/
+struct __themisv2_error__ {
+    int    code;
+    string message;
+};
+
+typedef __themisv2_error__ judgeerror;
+
+thread_local bool    __halt_throws__ = 0;
+thread_local string* __logcapture__  = NULL;
+
+/* Write logs. The line is queued, the logger's thread writes it to the logfile and the console. */
+void tolog (const string& r, int level = LOG_INFO) {
+    if (__logcapture__) {
+        if (level >= __logger__.getlevel())
+            *__logcapture__ += r + "\n";
+        return;
+    }
+    __logger__.push(level, r);
 }
 
 /* Date and Time. */
 string dt() {
     // Get time from Windows.
     time_t now = time(0);
-    tm *ltm = localtime(&now);
-
-    // Variables.
-    int mon  = ltm->tm_mon + 1,
-        day  = ltm->tm_mday,
-        hour = ltm->tm_hour,
-        minn = ltm->tm_min,
-        sec  = ltm->tm_sec;
+    char s[32];
 
     // Return the form [MM/DD/YYYY hh:mm:ss].
-    return string("0") * (mon < 10) + to_string(mon) + "/" +
-           string("0") * (day < 10) + to_string(day) + "/" +
-           to_string(1900 + ltm->tm_year) + " " +
-           string("0") * (hour < 10) + to_string(hour) + ":" +
-           string("0") * (minn < 10) + to_string(minn) + ":" +
-           string("0") * (sec < 10) + to_string(sec);
+    strftime(s, sizeof s, "%m/%d/%Y %H:%M:%S", localtime(&now));
+    return s;
 }
 
-/* Halt the program with message and exitcode. */
+/* Capture this thread's logs in *s* until the end of the scope. */
+class __themisv2_logcapture__ {
+private:
+    string* prev;
+public:
+    explicit __themisv2_logcapture__ (string* s): prev(__logcapture__) {
+        __logcapture__ = s;
+    }
+
+    ~__themisv2_logcapture__() {
+        __logcapture__ = prev;
+    }
+};
+
+typedef __themisv2_logcapture__ logcapture;
+
+/* Halt the program with message and exitcode (in library mode, throw them instead). */
 [[noreturn]] void halt (int exitcode, const string& message = "") {
     string t = rfmt("[%s] themisv2 returned exitcode %d (%s) with message: \"%s\"",
                     dt().c_str(),
                     exitcode,
                     trans(exitcode).c_str(),
                     message.c_str());
-    tolog(t);
+    if (__halt_throws__) {
+        tolog(t, LOG_ERROR);
+        throw judgeerror{exitcode, message};
+    }
+    // The program ends here: logs captured so far (eg. by a test) must reach the logfile and the console.
+    if (__logcapture__) {
+        string c = *__logcapture__;
+        __logcapture__ = NULL;
+        if (!c.empty())
+            tolog(c.substr(0, c.size() - 1));
+    }
+    tolog(t, LOG_ERROR);
+    __logger__.flush();
     exit(exitcode);
 }
 
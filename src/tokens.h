@@ -0,0 +1,400 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains the token stream: answers read from a pre-tokenized (and cached) form.
+**/
+#ifndef __THEMISV2_TOKENS__
+#define __THEMISV2_TOKENS__
+
+#include "themisv2.h"
+#include <limits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Tokenized form (all numbers are little-endian):
+   [header]  "THTK" (4 bytes), version (4 bytes).
+   [records] A type (1 byte), then:
+             - __TOK_LINE__:   nothing, the line ends here.
+             - __TOK_INT__:    the integer (8 bytes). Its text is exactly how it is printed.
+             - __TOK_DOUBLE__: the number (8 bytes), then its text's length (4 bytes) and its text.
+             - __TOK_WORD__:   its length (4 bytes) and the word.
+   Every line, the last one included, ends with a __TOK_LINE__ record.
+*/
+const char __TOK_MAGIC__[4] = {'T', 'H', 'T', 'K'};
+
+#define __TOK_LINE__   0
+#define __TOK_INT__    1
+#define __TOK_DOUBLE__ 2
+#define __TOK_WORD__   3
+
+/* Parse an integer that fits in a long long (the __TOK_INT__ records). Returns 0 if it is not one. */
+bool tok_parseint (const char* p, size_t n, ll& r) {
+    size_t i = n && p[0] == '-';
+    if (i == n || n - i > 19)
+        return 0;
+    ull v = 0;
+    for (size_t j = i; j < n; ++j) {
+        if (!isdigit((unsigned char)p[j]))
+            return 0;
+        v = v * 10 + (p[j] - '0');
+    }
+    if (v > (ull)LLONG_MAX)
+        return 0;
+    r = i ? -(ll)v : (ll)v;
+    return 1;
+}
+
+/* Parse the sign and the magnitude of an integer the way foo's readint() reads them ("-" is 0).
+   Returns 0 if it is not one, or if the magnitude does not fit in 64 bits.
+*/
+bool tok_parsemagnitude (const char* p, size_t n, bool& neg, ull& v) {
+    neg = n && p[0] == '-';
+    v   = 0;
+    for (size_t j = neg; j < n; ++j) {
+        if (!isdigit((unsigned char)p[j]) || v > (ULLONG_MAX - (p[j] - '0')) / 10)
+            return 0;
+        v = v * 10 + (p[j] - '0');
+    }
+    return 1;
+}
+
+/* Parse a real number the way foo's readdouble() accepts it (no exponent, "-" and ".5" included), to the same value.
+   Returns 0 if it is not one.
+*/
+bool tok_parsedouble (const char* p, size_t n, double& r) {
+    size_t i = n && p[0] == '-', j = i;
+    double v = 0;
+    while (j < n && isdigit((unsigned char)p[j]))
+        v = v * 10 + p[j++] - 48;
+    ll d = 1, t = 0;
+    if (j < n) {
+        if (p[j] != '.' || j + 1 == n)
+            return 0;
+        for (size_t k = j + 1; k < n; ++k) {
+            if (!isdigit((unsigned char)p[k]))
+                return 0;
+            if (d <= 100000000000000000LL)
+                t = t * 10 + p[k] - 48, d *= 10;
+        }
+    }
+    r = (v + (double)t / d) * (i ? -1 : 1);
+    return 1;
+}
+
+/* Tokenize a text. Tokens are split by spaces, lines by '\n' (CRs are dropped). */
+string tokenize (const char* p, size_t n) {
+    string r(__TOK_MAGIC__, 4);
+    ui version = 1;
+    r.append((const char*)&version, 4);
+    size_t i = 0;
+    while (i < n) {
+        const char* e = (const char*)memchr(p + i, '\n', n - i);
+        size_t end = e ? e - p : n;
+        while (i < end) {
+            while (i < end && (p[i] == ' ' || p[i] == '\r' || p[i] == '\t'))
+                ++i;
+            size_t j = i;
+            while (j < end && p[j] != ' ' && p[j] != '\r' && p[j] != '\t')
+                ++j;
+            if (j == i)
+                break;
+            ll v;
+            double d;
+            ui len = j - i;
+            if (tok_parseint(p + i, len, v) && to_string(v) == string(p + i, len)) {
+                r += (char)__TOK_INT__;
+                r.append((const char*)&v, 8);
+            } else if (tok_parsedouble(p + i, len, d)) {
+                r += (char)__TOK_DOUBLE__;
+                r.append((const char*)&d, 8);
+                r.append((const char*)&len, 4);
+                r.append(p + i, len);
+            } else {
+                r += (char)__TOK_WORD__;
+                r.append((const char*)&len, 4);
+                r.append(p + i, len);
+            }
+            i = j;
+        }
+        r += (char)__TOK_LINE__;
+        i = end + 1;
+    }
+    return r;
+}
+
+/* Where the tokenized form of a text (*n* bytes) is cached in folder *cache*. */
+string tokencache (const string& cache, const char* p, size_t n) {
+    return cache + string("\\") * (cache[cache.size() - 1] != '\\') + "tok_" + tohex(fnv(p, n)) + ".bin";
+}
+
+/* Where the tokenized form of a file is cached in folder *cache*, by the file's full path, size and last write time. */
+string tokencache (const string& cache, const string& fname, const struct stat& st) {
+    char full[4096];
+    string key = _fullpath(full, fname.c_str(), sizeof full) ? full : fname;
+    key += "|" + to_string((ll)st.st_size) + "|" + to_string((ll)st.st_mtime);
+    return cache + string("\\") * (cache[cache.size() - 1] != '\\') + "tokf_" + tohex(fnv(key.data(), key.size())) + ".bin";
+}
+
+/* Is *d* a whole tokenized form (every record inside it, the last one ending a line)? */
+bool tok_valid (const string& d) {
+    ui version;
+    if (d.size() < 9 || memcmp(d.data(), __TOK_MAGIC__, 4) || (memcpy(&version, d.data() + 4, 4), version != 1))
+        return 0;
+    size_t i = 8, n = d.size();
+    int t = __TOK_WORD__;
+    while (i < n) {
+        t = d[i++];
+        if (t == __TOK_LINE__)
+            continue;
+        if (t == __TOK_INT__ || t == __TOK_DOUBLE__) {
+            if (n - i < 8)
+                return 0;
+            i += 8;
+            if (t == __TOK_INT__)
+                continue;
+        } else if (t != __TOK_WORD__)
+            return 0;
+        ui len;
+        if (n - i < 4)
+            return 0;
+        memcpy(&len, d.data() + i, 4);
+        i += 4;
+        if (n - i < len)
+            return 0;
+        i += len;
+    }
+    return t == __TOK_LINE__;
+}
+
+/* A stream reading a text from its tokenized form, with foo's functions and exitcodes.
+   Tokenizing a text once and reading the tokens is much cheaper than parsing it character by character,
+   so use it for answers, which are read again for every submission:
+
+       foo out(output);
+       tokenstream ans(answer);
+
+   If the environment variable THEMISV2_TOKENS names a folder, tokenized forms are cached there,
+   keyed by the hash of the text, so a text is only tokenized the first time it is read. A file not written
+   in the last seconds is also keyed by its path, size and time, so it is not even read again.
+   A broken cached form is tokenized again.
+   Spaces are not checked (the *sp* arguments are ignored): answers are trusted.
+*/
+class __themisv2_tokenstream__ {
+private:
+    string data;  /* Tokenized form. */
+    size_t pos;   /* Next record. */
+    bool   _f;    /* Reminding judger to check exitcodes. */
+
+    /* Read a number from the record. */
+    template<typename T>
+    T get (size_t at) const {
+        T r;
+        memcpy(&r, data.data() + at, sizeof r);
+        return r;
+    }
+
+    /* Type of the next record (__TOK_LINE__ at the end). */
+    inline int peek() const {
+        return pos < data.size() ? data[pos] : __TOK_LINE__;
+    }
+
+    /* Text of the next token, then skip it. */
+    string text() {
+        int t = data[pos++];
+        if (t == __TOK_INT__) {
+            pos += 8;
+            return to_string(get<ll>(pos - 8));
+        }
+        if (t == __TOK_DOUBLE__)
+            pos += 8;
+        ui len = get<ui>(pos);
+        pos += 4 + len;
+        return data.substr(pos - len, len);
+    }
+
+    /* Load the tokenized form cached in *fn*. Returns 0 if it is missing or broken. */
+    bool loadcached (const string& fn) {
+        FILE* f = fopen(fn.c_str(), "rb");
+        if (!f)
+            return 0;
+        fseek(f, 0, SEEK_END);
+        long n = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        data.resize(n > 0 ? n : 0);
+        bool ok = n > 0 && fread(&data[0], 1, n, f) == (size_t)n && tok_valid(data);
+        fclose(f);
+        return ok;
+    }
+
+    /* Cache the tokenized form in *fn*. It is written under another name first, so nobody reads half of it. */
+    void savecached (const string& fn) {
+        string tmp = fn + "." + to_string(getpid()) + "_" + to_string((size_t)this) + ".tmp";
+        if (FILE* f = fopen(tmp.c_str(), "wb")) {
+            bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+            if (fclose(f) || !ok || rename(tmp.c_str(), fn.c_str()))
+                remove(tmp.c_str());
+        }
+    }
+public:
+    /* Registration with file name, and the cache's folder (THEMISV2_TOKENS if not given, no cache if empty). */
+    __themisv2_tokenstream__ (const string& fname, const char* cache = getenv("THEMISV2_TOKENS")): pos(8), _f(0) {
+        struct stat st;
+        if (stat(fname.c_str(), &st))
+            halt(crash, "Token stream: Can't open file!");
+        if (!st.st_size)
+            halt(crash, "Token stream: Empty file!");
+        string dir = cache ? cache : "", byfile;
+
+        // A file untouched for a while is found by its path, size and time without reading it.
+        // A newer one (eg. an answer staged for this very test) may still be rewritten within the same second,
+        // so it is only found by its content.
+        if (!dir.empty() && time(0) - st.st_mtime > 2) {
+            byfile = tokencache(dir, fname, st);
+            if (loadcached(byfile))
+                return;
+        }
+
+        FILE* f = fopen(fname.c_str(), "rb");
+        if (!f)
+            halt(crash, "Token stream: Can't open file!");
+        string raw;
+        char buf[1 << 16];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof buf, f)) > 0)
+            raw.append(buf, n);
+        fclose(f);
+        if (raw.empty())
+            halt(crash, "Token stream: Empty file!");
+        if (dir.empty()) {
+            data = tokenize(raw.data(), raw.size());
+            return;
+        }
+
+        string bytext = tokencache(dir, raw.data(), raw.size());
+        if (!loadcached(bytext)) {
+            data = tokenize(raw.data(), raw.size());
+            savecached(bytext);
+        }
+        if (!byfile.empty())
+            savecached(byfile);
+    }
+
+    /* Make sure everything before reading. */
+    void analyze() {
+        if (_f)
+            halt(crash, "Token stream: Be careful to check all exitcodes! There was an non-zero returned exitcode at the previous use of my stream.");
+    }
+
+    /* You have checked the exitcodes and it does not impact the result? Please let me know. */
+    void itsOK() {
+        _f = 0;
+    }
+
+    /* Read one integer. */
+    template<typename T>
+    int readint (T& n, int sp = inf) {
+        analyze();
+        n = 0;
+        if (peek() == __TOK_LINE__)
+            return _f = 1, 3;
+        // As foo does: the magnitude must fit in T, then the sign is applied in T (so "-5" wraps in unsigned types).
+        bool neg;
+        ull  v;
+        if (peek() == __TOK_INT__) {
+            ll x = get<ll>(pos + 1);
+            pos += 9;
+            neg = x < 0;
+            v   = neg ? 0 - (ull)x : (ull)x;
+        } else {
+            string s = text();
+            if (!tok_parsemagnitude(s.data(), s.size(), neg, v))
+                return _f = 1, 1;
+        }
+        if (v > (ull)numeric_limits<T>::max())
+            return _f = 1, 1;
+        n = (T)v;
+        n = n * (neg ? -1 : 1);
+        return 0;
+    }
+
+    /* Read one double. */
+    int readdouble (double& n, int sp = inf) {
+        analyze();
+        n = 0;
+        if (peek() == __TOK_LINE__)
+            return _f = 1, 3;
+        // Past 2^53 foo's digit by digit sum may round differently from the integer's conversion.
+        if (peek() == __TOK_INT__ && llabs(get<ll>(pos + 1)) <= (1LL << 53))
+            return n = (double)get<ll>(pos + 1), pos += 9, 0;
+        if (peek() == __TOK_INT__) {
+            string s = text();
+            return tok_parsedouble(s.data(), s.size(), n), 0;
+        }
+        if (peek() == __TOK_DOUBLE__)
+            return n = get<double>(pos + 1), text(), 0;
+        text();
+        return _f = 1, 1;
+    }
+
+    /* Read one word. */
+    int readword (string& s, int sp = inf) {
+        analyze();
+        if (peek() == __TOK_LINE__)
+            return _f = 1, 3;
+        s = text();
+        return 0;
+    }
+
+    /* Read the rest of the line, words split by one space. */
+    int readstring (string& s, int sp = inf) {
+        analyze();
+        s = "";
+        while (peek() != __TOK_LINE__)
+            s += (s.empty() ? "" : " ") + text();
+        return 0;
+    }
+
+    /* Jump to the next line. Returns 1 if the line has unread tokens, EOF at the end of the text. */
+    int readline() {
+        analyze();
+        bool left = peek() != __TOK_LINE__;
+        while (peek() != __TOK_LINE__)
+            text();
+        ++pos;
+        if (left)
+            return _f = 1, 1;
+        if (pos >= data.size())
+            return _f = 1, EOF;
+        return 0;
+    }
+
+    /* Jump to the next line and check it is the end of the text (0 if it is, 1 if the line has unread tokens, -1 otherwise). */
+    int readEOF() {
+        int chk = readline();
+        if (chk == 1)
+            return 1;
+        if (chk == EOF)
+            return 0;
+        return -1;
+    }
+};
+
+typedef __themisv2_tokenstream__ tokenstream;
+
+#endif // __THEMISV2_TOKENS__
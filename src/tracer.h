@@ -0,0 +1,160 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    This header is a part of themisv2 Project.
+    It contains a tracer that shows where judging time goes.
+**/
+#ifndef __THEMISV2_TRACER__
+#define __THEMISV2_TRACER__
+
+#include "themisv2.h"
+
+/* A tracer for timing every phase of judging.
+   It is off unless the environment variable THEMISV2_TRACE is set to the destination of the trace.
+
+   UNDERSTANDING:
+   --------------
+   - Each phase is one "complete" event (begin timestamp and duration, in microseconds).
+   - Events remember the thread they ran on and the test being judged by that thread.
+   - The trace is written when the program ends, in the Chrome trace format,
+     so you can open it with chrome://tracing or ui.perfetto.dev.
+*/
+class __themisv2_tracer__ {
+private:
+    /* One finished phase. Names must be string literals. */
+    struct event {
+        const char* name;
+        const char* cat;
+        ll          ts, dur;
+        DWORD       tid;
+        int         test;
+    };
+
+    /* Recorded events, guarded by *cs*. */
+    vector<event>    events;
+    CRITICAL_SECTION cs;
+
+    /* Destination of the trace. Empty means tracing is off. */
+    string path;
+
+    /* Performance counter frequency and the counter at startup. */
+    LARGE_INTEGER freq, base;
+
+    /* TLS index holding the test judged by the current thread. */
+    DWORD tls;
+public:
+    /* Initialization. */
+    __themisv2_tracer__() {
+        const char* env = getenv("THEMISV2_TRACE");
+        path = env ? env : "";
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&base);
+        InitializeCriticalSection(&cs);
+        tls = TlsAlloc();
+        if (on())
+            events.reserve(4096);
+    }
+
+    /* Write the trace before the program ends. */
+    ~__themisv2_tracer__() {
+        dump();
+        DeleteCriticalSection(&cs);
+    }
+
+    /* Is tracing on? */
+    inline bool on() const {
+        return !path.empty();
+    }
+
+    /* Microseconds since startup. */
+    ll now() const {
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        return (t.QuadPart - base.QuadPart) * 1000000 / freq.QuadPart;
+    }
+
+    /* Tell me which test the current thread is judging (-1 for none). */
+    void settest (int test) {
+        TlsSetValue(tls, (LPVOID)(ULONG_PTR)(test + 1));
+    }
+
+    /* Record one phase. */
+    void record (const char* name, const char* cat, ll ts, ll dur) {
+        event e = {name, cat, ts, dur, GetCurrentThreadId(), (int)(ULONG_PTR)TlsGetValue(tls) - 1};
+        EnterCriticalSection(&cs);
+        events.pb(e);
+        LeaveCriticalSection(&cs);
+    }
+
+    /* Write all recorded events to the trace. */
+    void dump() {
+        if (!on())
+            return;
+        EnterCriticalSection(&cs);
+        FILE* f = fopen(path.c_str(), "w");
+        if (f) {
+            fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+            for (size_t i = 0; i < events.size(); ++i) {
+                const event& e = events[i];
+                fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%lu,\"tid\":%lu",
+                        e.name, e.cat, e.ts, e.dur, (unsigned long)GetCurrentProcessId(), (unsigned long)e.tid);
+                if (e.test >= 0)
+                    fprintf(f, ",\"args\":{\"test\":%d}", e.test);
+                fprintf(f, "}%s\n", i + 1 < events.size() ? "," : "");
+            }
+            fprintf(f, "]}\n");
+            fclose(f);
+        }
+        events.clear();
+        LeaveCriticalSection(&cs);
+    }
+};
+
+__themisv2_tracer__ __tracer__;
+
+/* A phase lasting from construction to end() (or destruction, whichever comes first). */
+class __themisv2_tracescope__ {
+private:
+    const char* name;
+    const char* cat;
+    ll          ts;
+    bool        done;
+public:
+    __themisv2_tracescope__ (const char* _name, const char* _cat = "judge") {
+        name = _name;
+        cat  = _cat;
+        done = !__tracer__.on();
+        ts   = done ? 0 : __tracer__.now();
+    }
+
+    ~__themisv2_tracescope__() {
+        end();
+    }
+
+    /* Close the phase now. */
+    void end() {
+        if (done)
+            return;
+        done = 1;
+        __tracer__.record(name, cat, ts, __tracer__.now() - ts);
+    }
+};
+
+typedef __themisv2_tracescope__ tracescope;
+
+#endif // __THEMISV2_TRACER__
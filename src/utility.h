@@ -29,6 +29,7 @@ const size_t allowed_size = 10240;
 
 /* Create a copy of a text file. Specifically, *b* is a copy of *a*. */
 void duplicate (const string& a, const string& b) {
+    tracescope ts("duplicate");
     ifstream p;
     p.open(a);
     if (!p.is_open())
@@ -45,6 +46,210 @@ void duplicate (const string& a, const string& b) {
     q.close();
 }
 
+/* Write *n* bytes to a file at once. */
+void writefile (const string& fn, const char* data, size_t n) {
+    tracescope ts("write file");
+    HANDLE h = CreateFile(fn.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        halt(crash, "Utility header: Cannot open file for writing!");
+    while (n) {
+        DWORD w;
+        if (!WriteFile(h, data, (DWORD)min(n, (size_t)1 << 24), &w, NULL)) {
+            CloseHandle(h);
+            halt(crash, "Utility header: Cannot write file!");
+        }
+        data += w;
+        n    -= w;
+    }
+    CloseHandle(h);
+}
+
+/* Move file *a* to *b*, replacing it. If *a* does not exist, *b* does not exist afterwards either. */
+void movefile (const string& a, const string& b) {
+    DeleteFile(b.c_str());
+    MoveFile(a.c_str(), b.c_str());
+}
+
+/* --- Memory mapping tools begin here --- */
+
+/* A mapped piece of a file. It is unmapped when destroyed. */
+class __themisv2_mapview__ {
+private:
+    LPVOID      base;
+    const char* ptr;
+    size_t      len;
+
+    __themisv2_mapview__ (const __themisv2_mapview__&);
+    __themisv2_mapview__& operator= (const __themisv2_mapview__&);
+public:
+    __themisv2_mapview__(): base(NULL), ptr(""), len(0) {}
+
+    /* Map *n* bytes from *off* of a file mapping. Views must start at the allocation granularity. */
+    __themisv2_mapview__ (HANDLE mapping, ull off, size_t n): base(NULL), ptr(""), len(0) {
+        if (!n)
+            return;
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        ull start = off - off % si.dwAllocationGranularity;
+        base = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, (SIZE_T)(off - start + n));
+        if (!base)
+            halt(crash, "Utility header: Cannot map file!");
+        ptr = (const char*)base + (off - start);
+        len = n;
+    }
+
+    __themisv2_mapview__ (__themisv2_mapview__&& o): base(o.base), ptr(o.ptr), len(o.len) {
+        o.base = NULL;
+    }
+
+    __themisv2_mapview__& operator= (__themisv2_mapview__&& o) {
+        if (base)
+            UnmapViewOfFile(base);
+        base = o.base, ptr = o.ptr, len = o.len;
+        o.base = NULL;
+        return *this;
+    }
+
+    ~__themisv2_mapview__() {
+        if (base)
+            UnmapViewOfFile(base);
+    }
+
+    inline const char* data() const { return ptr; }
+    inline size_t      size() const { return len; }
+};
+
+typedef __themisv2_mapview__ mapview;
+
+/* A read-only file mapping. Take views of it with view(). */
+class __themisv2_filemap__ {
+private:
+    HANDLE file, mapping;
+    ull    total;
+
+    __themisv2_filemap__ (const __themisv2_filemap__&);
+    __themisv2_filemap__& operator= (const __themisv2_filemap__&);
+public:
+    __themisv2_filemap__(): file(INVALID_HANDLE_VALUE), mapping(NULL), total(0) {}
+
+    ~__themisv2_filemap__() {
+        close();
+    }
+
+    /* Open and map a file. Returns 0 if it cannot be opened. */
+    bool open (const string& fn) {
+        close();
+        file = CreateFile(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return 0;
+        DWORD high, low = GetFileSize(file, &high);
+        total = ((ull)high << 32) | low;
+        // Empty files cannot be mapped, but they have nothing to view anyway.
+        if (total && !(mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL))) {
+            close();
+            return 0;
+        }
+        return 1;
+    }
+
+    void close() {
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file    = INVALID_HANDLE_VALUE;
+        total   = 0;
+    }
+
+    inline bool is_open() const { return file != INVALID_HANDLE_VALUE; }
+    inline ull  size()    const { return total; }
+
+    /* View *n* bytes from *off*. */
+    mapview view (ull off, size_t n) const {
+        if (off + n > total)
+            halt(crash, "Utility header: Mapped view is out of the file!");
+        return mapview(mapping, off, n);
+    }
+};
+
+typedef __themisv2_filemap__ filemap;
+
+/* FNV-1a hash of a file's content (0 if it cannot be opened). Big files are hashed by pieces. */
+ull hashfile (const string& fn) {
+    tracescope ts("hash file");
+    filemap f;
+    if (!f.open(fn))
+        return 0;
+    const size_t piece = (size_t)1 << 26;
+    ull h = fnv("", 0);
+    for (ull off = 0; off < f.size(); off += piece) {
+        mapview v = f.view(off, (size_t)min((ull)piece, f.size() - off));
+        h = fnv(v.data(), v.size(), h);
+    }
+    return h;
+}
+
+/* Hash of an executable (or a DLL) that does not change when it is built again from the same source:
+   the link time and the checksum in its PE headers are not hashed. Other files are hashed as they are.
+*/
+ull hashbinary (const string& fn) {
+    tracescope ts("hash binary");
+    filemap f;
+    if (!f.open(fn))
+        return 0;
+    const size_t piece = (size_t)1 << 26;
+    ull h = fnv("", 0);
+    for (ull off = 0; off < f.size(); off += piece) {
+        mapview v = f.view(off, (size_t)min((ull)piece, f.size() - off));
+        if (off || v.size() < 64 || memcmp(v.data(), "MZ", 2)) {
+            h = fnv(v.data(), v.size(), h);
+            continue;
+        }
+        // The headers are hashed from a copy with the two fields zeroed.
+        string head(v.data(), min(v.size(), (size_t)4096));
+        ui pe;
+        memcpy(&pe, &head[0x3C], 4);
+        if ((size_t)pe + 92 <= head.size() && !memcmp(&head[pe], "PE\0\0", 4)) {
+            memset(&head[pe + 8], 0, 4);  // TimeDateStamp
+            memset(&head[pe + 88], 0, 4); // CheckSum
+        }
+        h = fnv(head.data(), head.size(), h);
+        h = fnv(v.data() + head.size(), v.size() - head.size(), h);
+    }
+    return h;
+}
+
+/* --- Comparison tools begin here --- */
+
+/* Is text *a* (*n* bytes) the same as text *b* (*m* bytes)?
+   Spaces, tabs and CRs at the end of lines and empty lines at the end of the texts do not matter.
+   Lines are compared with memcmp, so this is about as fast as reading both texts.
+*/
+bool sametext (const char* a, size_t n, const char* b, size_t m) {
+    while (n && isspace((unsigned char)a[n - 1]))
+        --n;
+    while (m && isspace((unsigned char)b[m - 1]))
+        --m;
+    size_t i = 0, j = 0;
+    while (i < n && j < m) {
+        const char *ea = (const char*)memchr(a + i, '\n', n - i),
+                   *eb = (const char*)memchr(b + j, '\n', m - j);
+        size_t la = ea ? ea - (a + i) : n - i,
+               lb = eb ? eb - (b + j) : m - j,
+               ka = la, kb = lb;
+        while (ka && (a[i + ka - 1] == ' ' || a[i + ka - 1] == '\t' || a[i + ka - 1] == '\r'))
+            --ka;
+        while (kb && (b[j + kb - 1] == ' ' || b[j + kb - 1] == '\t' || b[j + kb - 1] == '\r'))
+            --kb;
+        if (ka != kb || memcmp(a + i, b + j, ka))
+            return 0;
+        i += la + 1;
+        j += lb + 1;
+    }
+    return i >= n && j >= m;
+}
+
 /* --- Scoring tools begin here --- */
 
 /* Pre-calculate score for all tests. */
@@ -110,6 +315,8 @@ string pas_compile (const string& code, const string& __compilationlog__) {
    It will return "-1" if your file code has a compilation error.
 */
 string compile (string code, const string& __compilationlog__ = "") {
+    tracescope ts("compile");
+
     // First, I skip the extension part
     int i = (int)code.length() - 1;
     string chk; // Used for checking the extension
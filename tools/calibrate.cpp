@@ -0,0 +1,45 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Time limit calibration.
+
+    Usage: calibrate.exe [config] [runs] [factor] [memory factor] [reference solution] ...
+    It runs every reference solution *runs* times on every test of the config and rewrites its time and memory limits
+    (lines 11 and 12): the slowest time times *factor* and the largest memory times *memory factor* (see calibrate()).
+    Run it on a judging machine, with the same THEMISV2_CORES and THEMISV2_PRIORITY as judgements.
+    The temporary folder is THEMISV2_TEMP, or "themisv2_calibrate" in the system's temporary folder.
+**/
+#include "../src/judge.h"
+
+const ui __CALIBRATION_CAP__ = 60000; /* A reference running longer than this (ms) fails the calibration. */
+
+int main (int argc, char* argv[]) {
+    if (argc < 6 || atoi(argv[2]) < 1 || atof(argv[3]) < 1 || atof(argv[4]) < 1) {
+        fprintf(stderr, "Calibrate: Usage: calibrate.exe [config] [runs] [factor] [memory factor] [reference solution] ...\n");
+        return crash;
+    }
+    char t[MAX_PATH];
+    const char* env = getenv("THEMISV2_TEMP");
+    string temp = env && *env ? env : string(t, GetTempPath(MAX_PATH, t)) + "themisv2_calibrate";
+    temp += string("\\") * (temp[temp.size() - 1] != '\\');
+    CreateDirectory(temp.c_str(), NULL);
+    isolation();
+
+    judgecontext judge(argv[1], temp);
+    return judge.calibrate(vector<string>(argv + 5, argv + argc), atoi(argv[2]), __CALIBRATION_CAP__, atof(argv[3]), atof(argv[4]));
+}
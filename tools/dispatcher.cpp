@@ -0,0 +1,137 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Submission dispatcher.
+
+    Usage: dispatcher.exe [spool folder] [parallelism]
+    It judges the submissions dropped in the spool folder, *parallelism* at a time, in the order of the scheduler (see scheduler.h).
+    A submission to a parallel problem (see the cores option) counts as one judgement per core.
+    A submission is a file <name>.job:
+    [1st line] <contestant>
+    [2nd line] <config's destination>
+    [3rd line] "pretest" if it is judged on pretests (optional)
+    Its result is written to <name>.result: "<exitcode> <score>", then the error (if any), then the logs. Then the .job file is deleted.
+    The queue's depth and waiting times are written to status.txt in the spool folder every second.
+**/
+#include "../src/judge.h"
+#include "../src/scheduler.h"
+
+string    spool;
+scheduler queue;
+set<string> known;       /* Jobs already queued. */
+CRITICAL_SECTION knowncs;
+ui          parallelism;
+ui          freeslots;   /* Judgements that can still start (a submission takes one per core). */
+CRITICAL_SECTION slotcs, gate;
+
+/* Queue the new .job files of the spool folder. */
+void scan() {
+    WIN32_FIND_DATA f;
+    HANDLE h = FindFirstFile((spool + "*.job").c_str(), &f);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        string name = f.cFileName;
+        name = name.substr(0, name.size() - 4);
+        EnterCriticalSection(&knowncs);
+        bool fresh = known.insert(name).se;
+        LeaveCriticalSection(&knowncs);
+        if (!fresh)
+            continue;
+        // It may just have been judged (and deleted).
+        ifstream ins(spool + name + ".job");
+        if (!ins.is_open()) {
+            EnterCriticalSection(&knowncs);
+            known.erase(name);
+            LeaveCriticalSection(&knowncs);
+            continue;
+        }
+        queuedjob j;
+        string p;
+        j.id = name;
+        getline(ins, j.contestant);
+        getline(ins, j.config);
+        getline(ins, p);
+        j.pretest = trim(p) == "pretest";
+        j.cores   = max(1, atoi(problemoption(j.config, "cores", "1").c_str()));
+        queue.push(j);
+    } while (FindNextFile(h, &f));
+    FindClose(h);
+}
+
+/* A judging thread: each has its own temporary folder. */
+DWORD WINAPI judging (LPVOID arg) {
+    string temp = spool + rfmt("temp%d\\", (int)(size_t)arg);
+    for (;; Sleep(100)) {
+        queuedjob j;
+        while (queue.pop(j)) {
+            // Wide submissions wait for their slots behind the gate, so narrow ones cannot keep taking them.
+            ui need = min(j.cores, parallelism);
+            EnterCriticalSection(&gate);
+            for (;; Sleep(10)) {
+                EnterCriticalSection(&slotcs);
+                bool ok = freeslots >= need;
+                if (ok)
+                    freeslots -= need;
+                LeaveCriticalSection(&slotcs);
+                if (ok)
+                    break;
+            }
+            LeaveCriticalSection(&gate);
+
+            DWORD start = GetTickCount();
+            judgecontext judge(j.config, temp);
+            string error;
+            ui code = judge.run(error);
+            queue.done(j, GetTickCount() - start);
+            EnterCriticalSection(&slotcs);
+            freeslots += need;
+            LeaveCriticalSection(&slotcs);
+
+            string r = rfmt("%d %f\n", code, judge.main_score) + error + "\n" + judge.logs;
+            writefile(spool + j.id + ".result.tmp", r.data(), r.size());
+            movefile(spool + j.id + ".result.tmp", spool + j.id + ".result");
+            DeleteFile((spool + j.id + ".job").c_str());
+            EnterCriticalSection(&knowncs);
+            known.erase(j.id);
+            LeaveCriticalSection(&knowncs);
+        }
+    }
+    return 0;
+}
+
+int main (int argc, char* argv[]) {
+    if (argc != 3 || atoi(argv[2]) < 1) {
+        fprintf(stderr, "Dispatcher: Usage: dispatcher.exe [spool folder] [parallelism]\n");
+        return crash;
+    }
+    spool = string(argv[1]) + string("\\") * (argv[1][strlen(argv[1]) - 1] != '\\');
+    InitializeCriticalSection(&knowncs);
+    InitializeCriticalSection(&slotcs);
+    InitializeCriticalSection(&gate);
+    parallelism = freeslots = atoi(argv[2]);
+    isolation(); // Keep off the cores set aside for solutions (THEMISV2_CORES), before the judging threads use them.
+    for (ui i = 0; i < parallelism; ++i)
+        CloseHandle(CreateThread(NULL, 0, judging, (LPVOID)(size_t)i, 0, NULL));
+
+    for (;; Sleep(1000)) {
+        scan();
+        string s = rfmt("depth %d\noldest_wait_ms %d\naverage_wait_ms %f\n", (int)queue.depth(), (int)queue.oldestwait(), queue.averagewait());
+        writefile(spool + "status.txt", s.data(), s.size());
+    }
+}
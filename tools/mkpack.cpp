@@ -0,0 +1,50 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Test pack builder.
+
+    Usage: mkpack.exe [tests' folder] [pack] [fixed_input] [fixed_output]
+    - Without [fixed_input] and [fixed_output], tests are <testid>.in and <testid>.ans ("stdio" mode).
+    - With them, tests are folders <testid> holding the two files ("fixedio" mode).
+    The pack's name must end with ".pack". Put it as <tests' destination> in themisv2.cfg.
+**/
+#include "../src/testpack.h"
+
+int main (int argc, char* argv[]) {
+    if (argc != 3 && argc != 5)
+        halt(crash, "Pack builder: Usage: mkpack.exe [tests' folder] [pack] [fixed_input] [fixed_output]");
+    if (!ispack(argv[2]))
+        halt(crash, "Pack builder: The pack's name must end with \".pack\"!");
+
+    size_t n = argc == 3 ? buildpack(argv[1], 1, "", "", argv[2])
+                         : buildpack(argv[1], 0, argv[3], argv[4], argv[2]);
+    if (!n)
+        halt(crash, "Pack builder: No valid test found!");
+
+    // Check what has been built.
+    testpack p;
+    if (!p.open(argv[2]))
+        halt(crash, "Pack builder: Cannot open the built pack!");
+    for (size_t i = 0; i < p.count(); ++i) {
+        mapview in = p.input(i), ans = p.answer(i);
+        if (fnv(in.data(), in.size()) != p.entry(i).inhash || fnv(ans.data(), ans.size()) != p.entry(i).anshash)
+            halt(crash, rfmt("Pack builder: Test \"%s\" is corrupted!", p.entry(i).name));
+    }
+    tolog(rfmt("Packed %d tests into \"%s\".", (int)n, argv[2]));
+    return 0;
+}
@@ -0,0 +1,62 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Checker plugin host.
+
+    Usage: pluginhost.exe [checker plugin] --batch
+    It loads a checker plugin (see checker.h) and runs it as a batch checker, in its own process.
+    So a broken or untrusted plugin cannot take themisv2 down with it. Use "checker = isolated-plugin" in the problem's options.
+**/
+#include "../src/checker.h"
+#include "../src/utility.h"
+
+int main (int argc, char* argv[]) {
+    if (argc != 3 || string(argv[2]) != "--batch") {
+        fprintf(stderr, "Plugin host: Usage: pluginhost.exe [checker plugin] --batch\n");
+        return crash;
+    }
+    HMODULE h = LoadLibrary(argv[1]);
+    checkfn check = h ? (checkfn)GetProcAddress(h, "check") : NULL;
+    if (!check) {
+        fprintf(stderr, "Plugin host: Cannot load \"%s\"!\n", argv[1]);
+        return crash;
+    }
+
+    // Check every test themisv2 asks for. A missing file is empty.
+    regis_batch_checker(2, argv + 1);
+    while (next_test()) {
+        filemap f[3];
+        mapview v[3];
+        string  fn[3] = {input, output, answer};
+        for (int k = 0; k < 3; ++k)
+            if (f[k].open(fn[k]))
+                v[k] = f[k].view(0, (size_t)f[k].size());
+
+        char msg[4096] = "";
+        double p = check(v[0].data(), v[0].size(), v[1].data(), v[1].size(), v[2].data(), v[2].size(), msg, sizeof msg);
+        msg[sizeof msg - 1] = 0; // Whatever the plugin left there.
+        if (p < 0) {
+            // themisv2 finds out when its reply never comes.
+            fprintf(stderr, "Plugin host: %s\n", msg);
+            return crash;
+        }
+        reply(p, msg);
+    }
+    FreeLibrary(h);
+    return 0;
+}
@@ -0,0 +1,47 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Test compressor.
+
+    Usage: thzip.exe [files]       (compress every file to <file>.thz)
+           thzip.exe -d [files]    (decompress every <file>.thz to <file>)
+    Remove the uncompressed tests afterwards: themisv2 prefers them when both forms exist.
+**/
+#include "../src/codec.h"
+
+int main (int argc, char* argv[]) {
+    if (argc < 2)
+        halt(crash, "Compressor: Usage: thzip.exe [-d] [files]");
+    bool d = string(argv[1]) == "-d";
+    for (int i = 1 + d; i < argc; ++i) {
+        string fn = argv[i];
+        if (d) {
+            if (!isthz(fn))
+                halt(crash, rfmt("Compressor: \"%s\" is not a .thz file!", fn.c_str()));
+            thz_unpack(fn, fn.substr(0, fn.size() - 4));
+            tolog(rfmt("%s: decompressed.", fn.c_str()));
+        } else {
+            ifstream f(fn, ios::binary | ios::ate);
+            double raw = (double)f.tellg();
+            f.close();
+            double len = (double)thz_pack(fn, fn + ".thz");
+            tolog(rfmt("%s: %f percent of its size.", fn.c_str(), raw ? len / raw * 100 : 100.0));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/** themisv2 Project (compiled with MinGW - GNU C++11)
+    ---
+    Copyright (C) 2017 @quyenjd
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.ved.
+    ---
+    Worker agent.
+
+    Usage: worker.exe [coordinator's host] [port] [store folder]
+    It connects to a themisv2 running as a coordinator (THEMISV2_LISTEN) and judges the tests it is given.
+    THEMISV2_CLUSTER_KEY must hold the same secret as the coordinator's.
+    Solutions, checkers and test packs it gets are kept in the store folder, so they are sent only once.
+    Keep it next to pluginhost.exe (for isolated plugins). It runs until it is stopped.
+    Compile it like themisv2.cpp: it needs Winsock too (-lpsapi -lws2_32).
+**/
+#include "../src/cluster.h"
+
+int main (int argc, char* argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "Worker: Usage: worker.exe [coordinator's host] [port] [store folder]\n");
+        return crash;
+    }
+    const char* key = getenv("THEMISV2_CLUSTER_KEY");
+    if (!key || !*key) {
+        fprintf(stderr, "Worker: Set THEMISV2_CLUSTER_KEY to the coordinator's key.\n");
+        return crash;
+    }
+    string store = argv[3];
+    if (store[store.size() - 1] != '\\')
+        store += '\\';
+    serveworker(argv[1], argv[2], store, key);
+    return 0;
+}